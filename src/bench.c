@@ -0,0 +1,406 @@
+// Micro-benchmarks for the hot kernels of qm.c, build with:
+//   gcc -O2 -Wall -Wextra -fopenmp src/bench.c -o bin/bench.exe
+#define QM_NO_MAIN
+#include "qm.c"
+
+#ifdef __linux__
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <linux/perf_event.h>
+#endif
+
+#define BENCH_VARS 12                           // Variables of the synthetic cubes
+#define BENCH_MAX_RESULTS 256
+#define BENCH_NAME_LEN 64
+
+typedef struct {
+    char   name[BENCH_NAME_LEN];
+    const char *unit;                           // What one timed unit is, a pair or a whole call
+    double ns_per_unit;
+    double units_per_sec;
+    double efficiency;                          // Speedup over one thread divided by threads, 0 if not swept
+    long   cache_misses;                        // -1 if the counters are off or unavailable
+    long   branch_misses;
+} BenchResult;
+
+BenchResult RESULTS[BENCH_MAX_RESULTS];
+int NUM_RESULTS = 0;
+unsigned int BENCH_SEED = 12345;
+int NUM_REPS = 5;
+int PERF_FDS[2] = {-1, -1};
+int SAVED_STDOUT = -1;
+
+unsigned int benchRand(void) {
+    // Fixed LCG so every run sees the same levels and charts
+    BENCH_SEED = BENCH_SEED * 1103515245u + 12345u;
+    return (BENCH_SEED >> 8);
+}
+
+void quiet(void) {
+    // The kernels print progress lines, keep them out of the report
+    fflush(stdout);
+    SAVED_STDOUT = dup(STDOUT_FILENO);
+    freopen("/dev/null", "w", stdout);
+}
+
+void loud(void) {
+    fflush(stdout);
+    dup2(SAVED_STDOUT, STDOUT_FILENO);
+    close(SAVED_STDOUT);
+    SAVED_STDOUT = -1;
+}
+
+#ifdef __linux__
+int openCounter(unsigned long long config) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;                           // Counts the OpenMP pool as long as it starts later
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+void openCounters(void) {
+    #ifdef __linux__
+        PERF_FDS[0] = openCounter(PERF_COUNT_HW_CACHE_MISSES);
+        PERF_FDS[1] = openCounter(PERF_COUNT_HW_BRANCH_MISSES);
+    #endif
+    if (PERF_FDS[0] < 0 || PERF_FDS[1] < 0)
+        printf("Hardware counters unavailable, reporting timings only\n");
+}
+
+void startCounters(void) {
+    #ifdef __linux__
+        for (int i = 0; i < 2; i++) {
+            if (PERF_FDS[i] >= 0) {
+                ioctl(PERF_FDS[i], PERF_EVENT_IOC_RESET, 0);
+                ioctl(PERF_FDS[i], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    #endif
+}
+
+void stopCounters(long *cache_misses, long *branch_misses) {
+    long long counts[2] = {-1, -1};
+
+    #ifdef __linux__
+        for (int i = 0; i < 2; i++) {
+            if (PERF_FDS[i] >= 0) {
+                ioctl(PERF_FDS[i], PERF_EVENT_IOC_DISABLE, 0);
+                if (read(PERF_FDS[i], &counts[i], sizeof(counts[i])) != sizeof(counts[i]))
+                    counts[i] = -1;
+            }
+        }
+    #endif
+    (*cache_misses) = counts[0];
+    (*branch_misses) = counts[1];
+}
+
+MintermSet **makeLevel(int num_sets, int num_dashes) {
+    int i, k;
+    int start = CUBE_WIDTH - BENCH_VARS;
+    MintermSet **level = malloc(MAX_SETS * sizeof(MintermSet *));
+
+    for (i = 0; i < MAX_SETS; i++) {
+        level[i] = NULL;
+    }
+    // Random minterms with the same dash pattern, like one level of a real run
+    for (i = 0; i < num_sets; i++) {
+        level[i] = createMintermSet();
+        appendMinterm(level[i], benchRand() % (1 << BENCH_VARS));
+        intToBinary(level[i]->minterms[0], level[i]->binary);
+        for (k = 0; k < num_dashes; k++) {
+            level[i]->binary[start + k * 2] = '-';
+        }
+    }
+    return level;
+}
+
+MintermSet **makeChart(int num_primes, int num_mints, int *uniqueMints) {
+    int i, k;
+    MintermSet **chart = malloc(num_primes * sizeof(MintermSet *));
+
+    for (k = 0; k < num_mints; k++) {
+        uniqueMints[k] = k;
+    }
+    // Every prime covers a handful of minterms, and every minterm is covered
+    for (i = 0; i < num_primes; i++) {
+        chart[i] = createMintermSet();
+        for (k = 0; k < 8; k++) {
+            appendMinterm(chart[i], benchRand() % num_mints);
+        }
+        intToBinary(i, chart[i]->binary);
+        chart[i]->expr = malloc(CUBE_BYTES);
+        strcpy(chart[i]->expr, chart[i]->binary);
+    }
+    for (k = 0; k < num_mints; k++) {
+        appendMinterm(chart[k % num_primes], k);
+    }
+    return chart;
+}
+
+void record(const char *name, double seconds, double units, const char *unit, double efficiency,
+            long cache_misses, long branch_misses) {
+    BenchResult *result = &RESULTS[NUM_RESULTS++];
+
+    snprintf(result->name, BENCH_NAME_LEN, "%s", name);
+    result->unit = unit;
+    result->ns_per_unit = seconds * 1e9 / units;
+    result->units_per_sec = units / seconds;
+    result->efficiency = efficiency;
+    result->cache_misses = cache_misses;
+    result->branch_misses = branch_misses;
+
+    printf("%-36s %12.2f ns/%-4s %12.3e %4ss/s", name, result->ns_per_unit, unit, 
+           result->units_per_sec, unit);
+    if (efficiency > 0)
+        printf(" %6.1f%% eff", efficiency * 100);
+    if (cache_misses >= 0 && branch_misses >= 0)
+        printf(" %10ld cache-miss %10ld branch-miss", cache_misses, branch_misses);
+    NEW_LINE(1);
+}
+
+void benchBitDiff(int num_sets, int num_dashes) {
+    int i, j, rep;
+    volatile int sink = 0;                      // Keeps the compiler from dropping the calls
+    long cache_misses, branch_misses;
+    double best = 1e30;
+    double pairs = (double)num_sets * (num_sets - 1) / 2;
+    char name[BENCH_NAME_LEN];
+    MintermSet **level = makeLevel(num_sets, num_dashes);
+
+    for (rep = 0; rep < NUM_REPS; rep++) {
+        startCounters();
+        double start_time = omp_get_wtime();
+        for (i = 0; i < num_sets - 1; i++) {
+            for (j = i + 1; j < num_sets; j++) {
+                sink = bit_diff(level[i]->binary, level[j]->binary);
+            }
+        }
+        double run_time = omp_get_wtime() - start_time;
+        stopCounters(&cache_misses, &branch_misses);
+        if (run_time < best)
+            best = run_time;
+    }
+    (void)sink;
+
+    snprintf(name, BENCH_NAME_LEN, "bit_diff/n=%d/d=%d", num_sets, num_dashes);
+    record(name, best, pairs, "pair", 0, cache_misses, branch_misses);
+    deleteMintermSets(level, num_sets);
+}
+
+double runMerge(int num_sets, int num_dashes, long *cache_misses, long *branch_misses) {
+    int rep;
+    double best = 1e30;
+
+    for (rep = 0; rep < NUM_REPS; rep++) {
+        unsigned int seed = BENCH_SEED;
+        MintermSet **groups = makeLevel(num_sets, num_dashes);
+        MintermSet **new_groups = makeLevel(0, 0);
+        MintermSet **primeImps = makeLevel(0, 0);
+        int num_groups = num_sets;
+        int num_new_groups = 0;
+        int num_primeImps = 0;
+
+        // The pass frees the input level itself, so freeing is part of the time
+        quiet();
+        startCounters();
+        double start_time = omp_get_wtime();
+        merge_minterms(&groups, &num_groups, &new_groups, &num_new_groups,
+                       &primeImps, &num_primeImps, 0, NULL);
+        double run_time = omp_get_wtime() - start_time;
+        stopCounters(cache_misses, branch_misses);
+        loud();
+        if (run_time < best)
+            best = run_time;
+
+        // After the swap groups holds the merged level and new_groups the
+        // input level's array, already emptied by merge_minterms()
+        deleteMintermSets(groups, num_groups);
+        deleteMintermSets(new_groups, 0);
+        deleteMintermSets(primeImps, num_primeImps);
+        BENCH_SEED = seed;                      // Same level on every repetition
+    }
+    benchRand();
+    return best;
+}
+
+void benchMerge(int num_sets, int num_dashes, int max_threads) {
+    int threads = 1;
+    long cache_misses, branch_misses;
+    double one_thread = 0;
+    double pairs = (double)num_sets * (num_sets - 1) / 2;
+    char name[BENCH_NAME_LEN];
+
+    // Thread scaling, efficiency is the speedup over one thread per thread.
+    // Powers of two, and max_threads itself last when it is not one of them
+    while (1) {
+        omp_set_num_threads(threads);
+        double best = runMerge(num_sets, num_dashes, &cache_misses, &branch_misses);
+        if (threads == 1)
+            one_thread = best;
+        snprintf(name, BENCH_NAME_LEN, "merge_minterms/n=%d/d=%d/t=%d", num_sets, num_dashes, threads);
+        record(name, best, pairs, "pair", one_thread / best / threads, cache_misses, branch_misses);
+        if (threads >= max_threads)
+            break;
+        threads = (threads * 2 < max_threads) ? threads * 2 : max_threads;
+    }
+    omp_set_num_threads(max_threads);
+}
+
+void benchCover(int num_primes, int num_mints) {
+    int i, rep;
+    long cache_misses, branch_misses;
+    double best = 1e30;
+    char name[BENCH_NAME_LEN];
+    int *uniqueMints = malloc(num_mints * sizeof(int));
+
+    for (rep = 0; rep < NUM_REPS; rep++) {
+        unsigned int seed = BENCH_SEED;
+        MintermSet **chart = makeChart(num_primes, num_mints, uniqueMints);
+        int num_chart = num_primes;
+        int num_uniqueMints = num_mints;
+        Expression *result = NULL;
+        int num_result = 0;
+
+        // The whole covering loop, column_dominance() and row_dominance() stop
+        // at their first pick so one call of either is no fixed amount of work
+        quiet();
+        startCounters();
+        double start_time = omp_get_wtime();
+        exactCover(chart, &num_chart, &result, &num_result, uniqueMints, &num_uniqueMints, 0);
+        double run_time = omp_get_wtime() - start_time;
+        stopCounters(&cache_misses, &branch_misses);
+        loud();
+        if (run_time < best)
+            best = run_time;
+
+        deleteExpression(result, num_result);
+        for (i = 0; i < num_chart; i++) {
+            deleteMintermSet(chart[i]);
+        }
+        free(chart);
+        BENCH_SEED = seed;
+    }
+    benchRand();
+
+    snprintf(name, BENCH_NAME_LEN, "exact_cover/p=%d/m=%d", num_primes, num_mints);
+    record(name, best, 1, "call", 0, cache_misses, branch_misses);
+    free(uniqueMints);
+}
+
+void saveBaseline(const char *path) {
+    FILE *file = fopen(path, "w");
+
+    if (file == NULL) {
+        printf("Could not write baseline %s\n", path);
+        return;
+    }
+    for (int i = 0; i < NUM_RESULTS; i++) {
+        fprintf(file, "%s %.4f\n", RESULTS[i].name, RESULTS[i].ns_per_unit);
+    }
+    fclose(file);
+    printf("Saved baseline to %s\n", path);
+}
+
+int compareBaseline(const char *path, double threshold) {
+    int i;
+    int num_regressions = 0;
+    char name[BENCH_NAME_LEN];
+    double baseline_ns;
+    FILE *file = fopen(path, "r");
+
+    if (file == NULL) {
+        printf("Could not read baseline %s\n", path);
+        return 1;
+    }
+
+    NEW_LINE(1);
+    printf("Compared to %s (fail above +%.0f%%):\n", path, threshold);
+    while (fscanf(file, "%63s %lf", name, &baseline_ns) == 2) {
+        for (i = 0; i < NUM_RESULTS; i++) {
+            if (strcmp(RESULTS[i].name, name))
+                continue;
+            double change = (RESULTS[i].ns_per_unit - baseline_ns) / baseline_ns * 100;
+            int regressed = change > threshold;
+            printf("%-36s %12.2f -> %12.2f ns/%-4s %+7.1f%%%s\n", name, baseline_ns,
+                   RESULTS[i].ns_per_unit, RESULTS[i].unit, change, regressed ? "  REGRESSION" : "");
+            num_regressions += regressed;
+        }
+    }
+    fclose(file);
+    return num_regressions > 0;
+}
+
+void benchUsage(const char *prog) {
+    printf("Usage: %s [-r reps] [-T threads] [-p] [-s file] [-c file] [-x percent]\n", prog);
+    printf("  -r    repetitions per kernel, the fastest one counts (default 5)\n");
+    printf("  -T    highest thread count of the scaling sweep (default NUM_THREADS)\n");
+    printf("  -p    read cache and branch misses through perf_event\n");
+    printf("  -s    save the results as a baseline\n");
+    printf("  -c    compare against a saved baseline, exit 1 on a regression\n");
+    printf("  -x    regression threshold in percent of the time per pair or call (default 10)\n");
+}
+
+int main(int argc, char **argv) {
+    int opt, i, d;
+    int max_threads = NUM_THREADS;
+    int counters = 0;
+    double threshold = 10;
+    char *save_path = NULL;
+    char *compare_path = NULL;
+    const int level_sizes[] = {256, 1024, 4096};
+    const int dash_counts[] = {0, 2, 4};
+
+    while ((opt = getopt(argc, argv, "r:T:ps:c:x:")) != -1) {
+        switch (opt) {
+            case 'r': NUM_REPS = atoi(optarg); break;
+            case 'T': max_threads = atoi(optarg); break;
+            case 'p': counters = 1; break;
+            case 's': save_path = optarg; break;
+            case 'c': compare_path = optarg; break;
+            case 'x': threshold = atof(optarg); break;
+            default:
+                benchUsage(argv[0]);
+                return 1;
+        }
+    }
+    if (NUM_REPS < 1 || max_threads < 1) {
+        benchUsage(argv[0]);
+        return 1;
+    }
+
+    // Counters have to exist before the OpenMP pool so its threads inherit them
+    if (counters)
+        openCounters();
+    selectCubeWidth(BENCH_VARS);
+
+    PRINT(60, '=');
+    NEW_LINE(1);
+    for (i = 0; i < (int)ARR_LEN(level_sizes); i++) {
+        for (d = 0; d < (int)ARR_LEN(dash_counts); d++) {
+            benchBitDiff(level_sizes[i], dash_counts[d]);
+        }
+    }
+    for (i = 0; i < (int)ARR_LEN(level_sizes); i++) {
+        for (d = 0; d < (int)ARR_LEN(dash_counts); d++) {
+            benchMerge(level_sizes[i], dash_counts[d], max_threads);
+        }
+    }
+    benchCover(64, 256);
+    benchCover(256, 1024);
+    PRINT(60, '=');
+    NEW_LINE(1);
+
+    if (save_path != NULL)
+        saveBaseline(save_path);
+    if (compare_path != NULL)
+        return compareBaseline(compare_path, threshold);
+    return 0;
+}
@@ -3,13 +3,37 @@
 #include <string.h>
 #include <stdint.h>
 #include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <signal.h>
 #include <omp.h>
 
-#define MAX_VARS 13                             // Use just one more or many more than needed for correct results
+#define MAX_VARS 256                            // Widest cube input, minterm sets stop at the widest kernel
+#define MAX_MINTERM_VARS 30                     // Minterms are ints, wider functions need cube input
 #define MAX_SETS 1000000                        // Increase if segfault
 
 #define ENABLE_MP 1                             // Enable or disable Multi-Threading
 #define NUM_THREADS 12                          // Set number of threads
+#define MERGE_TILE 64                           // Sets per side of one comparison tile, two blocks fit in L1
+
+#define DENSITY_THRESHOLD 0.75                  // Above this on-set density the off-set is minimized instead
+#define SHARD_WORKER_CMD "/proc/self/exe"       // Started with "worker" for every shard
+#define MAX_SHARD_WORKERS 16                    // Shard workers running at once
+#define SERVER_BACKLOG 128                      // Pending connections queued by the server
+#define MAX_REQUEST_BYTES (64 << 20)            // Largest request the server will read
+#define SERVER_TIMEOUT 5                        // Seconds a client may stall mid request before it is dropped
+#define SERVER_MAX_SHARD_VARS 4                 // Largest shard_vars a request may ask for
+#define REQUEST_FIELDS 7                        // num_variables num_minterms num_donts form shard_vars budget_kb cover
+#define EXPR_LEN(num_vars) ((num_vars) * 8 + 3) // Worst case chars of a term or clause plus \0
+#define CUBE_BYTES (CUBE_WIDTH + 1)             // Binary of one cube plus \0 at the current width
+#define LEVEL_SPILLED 2                         // merge_minterms() wrote the next level to cube runs
+#define CUBE_WORDS (MAX_VARS / 32)              // 64-bit words of a packed cube, 2 bits per variable
+#define FIELD_LOW_BITS 0x5555555555555555ULL    // Low bit of every 2-bit field in a packed word
 
 #define NEW_LINE(num) \
     for (int i = 0; i < (num); i++) \
@@ -25,31 +49,87 @@
 
 #define ARR_LEN(arr) (sizeof(arr) / sizeof((arr)[0]))
 
+// Output forms, FORM_AUTO picks POS when the on-set is dense
+enum { FORM_AUTO, FORM_SOP, FORM_POS };
+// Covering, exact runs the dominance loop and greedy a lazy heap set cover
+enum { COVER_EXACT, COVER_GREEDY };
+
 typedef struct {
     int *minterms;
     int  num_minterms;
-    char binary[MAX_VARS];
+    char *expr;
     int  isPrimeImplicant;
+    int  isCombined;                            // Set once the set takes part in a merge
+    char binary[];                              // CUBE_WIDTH chars plus \0
 } MintermSet;
 
 typedef struct {
     char *expr;
 } Expression;
 
+// A bucket of one merge level kept on disk as fixed CUBE_BYTES records
+typedef struct {
+    FILE *file;
+    int   num_cubes;
+} CubeRun;
+
+// Merges one thread found in a merge pass, as i, j, bit_pos triples
+typedef struct {
+    int *merges;
+    int  num_merges;
+    int  max_merges;
+} MergeBuffer;
+
+// One merge of a pass with the binary it produces
+typedef struct {
+    char *binary;
+    int   first;
+    int   second;
+} MergePair;
+
+// Cubes in positional notation for the consensus engine, num_words words per
+// cube. Per variable 01 is 0, 10 is 1, 11 is a dash and 00 empties the cube
+typedef struct {
+    uint64_t *cubes;
+    int       num_cubes;
+    int       max_cubes;
+    int       num_words;
+} PackedCover;
+
+// Heap entry of the greedy cover, count is the uncovered minterms when pushed
+typedef struct {
+    int count;
+    int dashes;
+    int prime;
+} CoverEntry;
+
+// Pointer arrays of MAX_SETS slots for one run. They are allocated once and
+// left all NULL after every run, so repeated calls skip the malloc and zero fill
+MintermSet **GROUPS_ARENA = NULL;
+MintermSet **NEW_GROUPS_ARENA = NULL;
+MintermSet **PRIMES_ARENA = NULL;
+
 int NUM_GROUP_PRINTS = 0;
 int NUM_TABLE_PRINTS = 0;
+int OUTPUT_FORM = FORM_AUTO;
+int COVER_MODE = COVER_EXACT;
+int NUM_SHARD_VARS = 0;
+long MEMORY_BUDGET = 0;                         // Bytes a merge level may use before it goes to disk, 0 = no limit
+int CUBE_WIDTH = 8;                             // Chars per binary, set by selectCubeWidth()
 
 MintermSet *createMintermSet() {
-    MintermSet *newList = malloc(sizeof(MintermSet));
+    MintermSet *newList = malloc(sizeof(MintermSet) + CUBE_BYTES);
     if (newList == NULL) {   
         printf("Error creating MintermSet\n");
         return NULL;
     }
 
     newList->minterms = NULL;
+    newList->expr = NULL;
     newList->num_minterms = 0;
     newList->isPrimeImplicant = 0;
-    newList->binary[0] = '\0';
+    newList->isCombined = 0;
+    memset(newList->binary, '\0', CUBE_BYTES);
 
     return newList;
 }
@@ -63,6 +143,7 @@ void deleteMintermSets(MintermSet** lists, int num_lists) {
                 free(lists[i]->minterms);
                 lists[i]->minterms = NULL;
             }
+            free(lists[i]->expr);
             free(lists[i]);
             lists[i] = NULL;
         }
@@ -73,6 +154,33 @@ void deleteMintermSets(MintermSet** lists, int num_lists) {
     }
 }
 
+MintermSet **arenaSets(MintermSet ***arena) {
+    if ((*arena) == NULL) {
+        (*arena) = malloc(MAX_SETS * sizeof(MintermSet *));
+        if ((*arena) == NULL) {
+            printf("Error allocating MintermSet arena\n");
+            return NULL;
+        }
+        for (int i = 0; i < MAX_SETS; i++) {
+            (*arena)[i] = NULL;
+        }
+    }
+    return (*arena);
+}
+
+void deleteMintermSet(MintermSet* list);
+
+void releaseSets(MintermSet **sets, int num_live, int num_used) {
+    // Free the live sets, then clear every slot that was used, since removing
+    // from the middle leaves stale copies behind the live ones
+    for (int i = 0; i < num_live; i++) {
+        deleteMintermSet(sets[i]);
+    }
+    for (int i = 0; i < num_used; i++) {
+        sets[i] = NULL;
+    }
+}
+
 void deleteMintermSet(MintermSet* list) {
     if(list == NULL)
         return;
@@ -80,6 +188,7 @@ void deleteMintermSet(MintermSet* list) {
         free(list->minterms);
         list->minterms = NULL;
     }   
+    free(list->expr);
     free(list);
     list = NULL;
 }
@@ -170,7 +279,12 @@ void copyMintermSet(MintermSet *list1, MintermSet *list2) {
     // Copy the rest
     list1->num_minterms = list2->num_minterms;
     list1->isPrimeImplicant = list2->isPrimeImplicant;
+    list1->isCombined = list2->isCombined;
     strcpy(list1->binary, list2->binary);
+    if (list2->expr != NULL) {
+        list1->expr = malloc((strlen(list2->expr) + 1) * sizeof(char));
+        strcpy(list1->expr, list2->expr);
+    }
 }
 
 void print_groups(MintermSet **groups, int num_groups) {
@@ -212,8 +326,13 @@ void printPrimeImplicantTable(MintermSet **primeImps, int num_primeImps,
         }
     }
 
-    int binarySpacing = MAX_VARS;
+    int binarySpacing = 0;
     int mintSpacing = maxMintLen + 1;
+    for (i = 0; i < num_primeImps; i++) {
+        if ((int)strlen(primeImps[i]->expr) + 1 > binarySpacing) {
+            binarySpacing = strlen(primeImps[i]->expr) + 1;
+        }
+    }
     // Print the minterms
     SPACES(1);
     printf("%-*s", binarySpacing,"");
@@ -225,7 +344,7 @@ void printPrimeImplicantTable(MintermSet **primeImps, int num_primeImps,
     // Print the table rows
     for (i = 0; i < num_primeImps; i++) {
         MintermSet *primeImp = primeImps[i];
-        printf("\033[0;34m%-*s\033[1;0m", binarySpacing, primeImp->binary);
+        printf("\033[0;34m%-*s\033[1;0m", binarySpacing, primeImp->expr);
         for (j = 0; j < num_uniqueMints; j++) {
             int found = 0;
             for (k = 0; k < primeImp->num_minterms; k++) {
@@ -244,54 +363,97 @@ void printPrimeImplicantTable(MintermSet **primeImps, int num_primeImps,
     }
 }
 
-void printExpression(Expression *list, int num_list) {
+char *joinExpression(Expression *list, int num_list, int form) {
     int i;
+    size_t length = 1;
+    char *joined;
 
-    NEW_LINE(1);
-    printf("\033[0;31mF = ");
     for(i = 0; i < num_list; i++) {
-        if(i != num_list - 1) {
-            printf("%s + ", list[i].expr);
-        }
-        else {
-            printf("%s", list[i].expr);
+        length += strlen(list[i].expr) + 3;
+    }
+    joined = malloc(length);
+    joined[0] = '\0';
+    for(i = 0; i < num_list; i++) {
+        strcat(joined, list[i].expr);
+        // Clauses of a POS are just written next to each other
+        if(i != num_list - 1 && form != FORM_POS) {
+            strcat(joined, " + ");
         }
     }
-    printf("\033[0;0m");
+    return joined;
+}
+
+void printExpression(Expression *list, int num_list, int form) {
+    char *joined = joinExpression(list, num_list, form);
+
+    NEW_LINE(1);
+    printf("\033[0;31mF = %s\033[0;0m", joined);
     NEW_LINE(1);
+    free(joined);
 }
 
-int bit_diff(const char *first_binary, const char *second_binary) {
-    int i;
-    int num_diff_bits = 0;
-    int different_bit = 0;
-    int LEN = MAX_VARS - 1;
+// bit_diff() kernels, one per cube width. Each compares 8 chars of the binaries
+// at a time and returns the position of the only char that differs, or -1
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    #define DIFF_BYTE(diff) (__builtin_clzll(diff) / 8)
+    #define BYTE_MASK(byte) (0xFFULL << ((7 - (byte)) * 8))
+#else
+    #define DIFF_BYTE(diff) (__builtin_ctzll(diff) / 8)
+    #define BYTE_MASK(byte) (0xFFULL << ((byte) * 8))
+#endif
+
+#define DEFINE_BIT_DIFF(WIDTH) \
+int bit_diff_##WIDTH(const char *first_binary, const char *second_binary) { \
+    int different_bit = -1; \
+    for (int i = 0; i < (WIDTH); i += 8) { \
+        uint64_t first, second, diff; \
+        memcpy(&first, &first_binary[i], 8); \
+        memcpy(&second, &second_binary[i], 8); \
+        diff = first ^ second; \
+        if (diff == 0) \
+            continue; \
+        int byte = DIFF_BYTE(diff); \
+        if (different_bit >= 0 || (diff & ~BYTE_MASK(byte)) != 0) \
+            return -1; \
+        different_bit = i + byte; \
+    } \
+    return different_bit; \
+}
 
-    for(i = 0; i < LEN; i++) {
-        if(first_binary[i] != second_binary[i]) {
-            num_diff_bits++;
-            different_bit = i;
+DEFINE_BIT_DIFF(8)
+DEFINE_BIT_DIFF(16)
+DEFINE_BIT_DIFF(32)
 
-            if(num_diff_bits > 1) {
-                return 0;
-            }
-        }
-    }
+typedef int (*BitDiffKernel)(const char *, const char *);
 
-    if(num_diff_bits == 1) {
-        return different_bit;
-    }
-    else {
-        return 0;
+const struct {
+    int width;
+    BitDiffKernel kernel;
+} CUBE_KERNELS[] = {
+    {8, bit_diff_8}, {16, bit_diff_16}, {32, bit_diff_32}};
+
+BitDiffKernel bit_diff = bit_diff_8;
+
+int selectCubeWidth(int num_variables) {
+    // Narrowest kernel that fits, every MintermSet made from now on has its width
+    for (int i = 0; i < (int)ARR_LEN(CUBE_KERNELS); i++) {
+        if (num_variables <= CUBE_KERNELS[i].width) {
+            CUBE_WIDTH = CUBE_KERNELS[i].width;
+            bit_diff = CUBE_KERNELS[i].kernel;
+            return 1;
+        }
     }
+    printf("%d variables is more than the widest kernel (%d)\n", num_variables, 
+           CUBE_KERNELS[ARR_LEN(CUBE_KERNELS) - 1].width);
+    return 0;
 }
 
-void intToBinary(int number, char binary[MAX_VARS]) {
+void intToBinary(int number, char *binary) {
     int i, d;
-    int pos = MAX_VARS - 1;
+    int pos = CUBE_WIDTH;
 
     // Fill binary with 0's
-    for (i = 0; i < MAX_VARS; i++) {
+    for (i = 0; i < CUBE_WIDTH; i++) {
         binary[i] = '0';
     }
 
@@ -310,13 +472,10 @@ void intToBinary(int number, char binary[MAX_VARS]) {
     }
 }
 
-void convertBinaryToExpression(char *binary, int num_variables) {
+void convertBinaryToExpression(const char *binary, int num_variables, int form, char *expr) {
     int i;
     int LEN = strlen(binary);
-    // Negation will be also appended so size hasto incease to account it plus \0
-    char newBinary[num_variables * 2 + 1];  
-    int num_newBinary = 0;
-    newBinary[0] = '\0';
+    int num_expr = 0;
 
     const char uppercaseLetters[] = {
         'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 
@@ -324,42 +483,44 @@ void convertBinaryToExpression(char *binary, int num_variables) {
         'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z'};
     int num_letters = 0;
 
+    // A POS clause comes from an off-set cube, so every literal is negated
+    if(form == FORM_POS) {
+        expr[num_expr++] = '(';
+    }
+
     int start = LEN - num_variables;
     for(i = start; i < LEN; i++) {
         if(binary[i] == '-') {
             num_letters++;
             continue;
         }
-        if(binary[i] == '0') {
-            newBinary[num_newBinary++] = uppercaseLetters[num_letters++];
-            newBinary[num_newBinary++] = '\'';
+        if(form == FORM_POS && num_expr > 1) {
+            strcpy(&expr[num_expr], " + ");
+            num_expr += 3;
+        }
+        if(num_letters < (int)ARR_LEN(uppercaseLetters)) {
+            expr[num_expr++] = uppercaseLetters[num_letters];
+        } else {
+            // Past Z the variables are just numbered
+            num_expr += sprintf(&expr[num_expr], "v%d", num_letters + 1);
         }
-        else if(binary[i] == '1') {
-            newBinary[num_newBinary++] = uppercaseLetters[num_letters++];
+        num_letters++;
+        if((binary[i] == '0') != (form == FORM_POS)) {
+            expr[num_expr++] = '\'';
         }
     }
-    newBinary[num_newBinary] = '\0';
-    strcpy(binary, newBinary);
-}
-
-void markPrimeImplicants(MintermSet **groups, int num_groups, 
-                         MintermSet **new_groups, int num_new_groups) {
-    int i, j;
-
-    #if ENABLE_MP
-        #pragma omp parallel for private(j) schedule(dynamic)
-    #endif
-    for (i = 0; i < num_groups; i++) {
-        int isPrime = 1;
 
-        for (j = 0; j < num_new_groups; j++) {
-            if (bit_diff(groups[i]->binary, new_groups[j]->binary)) {
-                isPrime = 0;
-                break;
-            }
+    // A cube without literals is the constant itself
+    if(form == FORM_POS) {
+        if(num_expr == 1) {
+            expr[0] = '0';
+        } else {
+            expr[num_expr++] = ')';
         }
-        groups[i]->isPrimeImplicant = isPrime;
+    } else if(num_expr == 0) {
+        expr[num_expr++] = '1';
     }
+    expr[num_expr] = '\0';
 }
 
 void extractUniqueMinterms(MintermSet **groups, int num_groups, 
@@ -402,12 +563,6 @@ void bubbleSort(int *arr, int num_arr) {
     }
 }
 
-int compareBinary(const void* p, const void* q) {
-    MintermSet* left =  *((MintermSet**)p);
-    MintermSet* right = *((MintermSet**)q);
-    return strcmp(left->binary, right->binary);
-}
-
 void mergeArrays(int *minterms, int num_minterms, int *donts, int num_donts, 
                  int *combined_minterms) {
     int i = 0, j = 0, k = 0;
@@ -422,6 +577,39 @@ void mergeArrays(int *minterms, int num_minterms, int *donts, int num_donts,
     bubbleSort(combined_minterms, (num_minterms + num_donts));
 }
 
+int *complementMinterms(int *minterms, int num_minterms, int *donts, int num_donts, 
+                        int num_variables, int *num_offset) {
+    int i;
+    int num_space = 1 << num_variables;
+    char *covered = calloc(num_space, sizeof(*covered));
+    int *offset = malloc(num_space * sizeof(*offset));
+
+    if (covered == NULL || offset == NULL) {
+        printf("Memory allocation error in complementMinterms\n");
+        free(covered);
+        free(offset);
+        return NULL;
+    }
+
+    // Everything that is neither a minterm nor a don't care is a maxterm
+    for(i = 0; i < num_minterms; i++) {
+        if(minterms[i] >= 0 && minterms[i] < num_space)
+            covered[minterms[i]] = 1;
+    }
+    for(i = 0; i < num_donts; i++) {
+        if(donts[i] >= 0 && donts[i] < num_space)
+            covered[donts[i]] = 1;
+    }
+
+    (*num_offset) = 0;
+    for(i = 0; i < num_space; i++) {
+        if(!covered[i])
+            offset[(*num_offset)++] = i;
+    }
+    free(covered);
+    return offset;
+}
+
 void removeDontCares(int *minterms, int *num_minterms, int *donts, int num_donts) {
     int i,j,k;
 
@@ -429,10 +617,13 @@ void removeDontCares(int *minterms, int *num_minterms, int *donts, int num_donts
         for(j = 0; j < num_donts; j++) {
 
             if(minterms[i] == donts[j]) {
-                for(k = i; k < (*num_minterms); k++) {
+                for(k = i; k < (*num_minterms) - 1; k++) {
                     minterms[k] = minterms[k + 1];
                 }
                 (*num_minterms)--;
+                // Check the minterm shifted into i against all don't cares too
+                i--;
+                break;
             }
         }
     }
@@ -461,10 +652,10 @@ int column_dominance(MintermSet **primeTable, int *num_primeTable, Expression **
         
         if (essential == 1) {
             can_remove = 1;
-            appendExpression(result, num_result, primeTable[implicant_pos]->binary);
+            appendExpression(result, num_result, primeTable[implicant_pos]->expr);
 
             if(printEnabled){
-                printf("prime implicant \033[0;31m%s\033[1;0m is essential\n", primeTable[implicant_pos]->binary);
+                printf("prime implicant \033[0;31m%s\033[1;0m is essential\n", primeTable[implicant_pos]->expr);
                 printf("remove minterms ");
             }  
 
@@ -515,9 +706,9 @@ int row_dominance(MintermSet **primeTable, int *num_primeTable,  Expression **re
 
         if(essential == 1){
             can_remove = 1;
-            appendExpression(result, num_result, row->binary);
+            appendExpression(result, num_result, row->expr);
             if(printEnabled) {
-                printf("prime implicant \033[0;31m%s\033[1;0m is essential\n", row->binary);
+                printf("prime implicant \033[0;31m%s\033[1;0m is essential\n", row->expr);
                 printf("remove minterms ");
             }
 
@@ -546,97 +737,379 @@ int row_dominance(MintermSet **primeTable, int *num_primeTable,  Expression **re
     return can_remove;
 }
 
+void exactCover(MintermSet **primeTable, int *num_primeTable, Expression **result, int *num_result, 
+                int *uniqueMints, int *num_uniqueMints, int printEnabled) {
+    int i;
+    int col_done = 1;
+    int row_done = 1;
+
+    // While there are still minterms find essential prime implicants
+    while((*num_uniqueMints)) {
+        col_done = 1;
+        while(col_done) {
+            col_done = column_dominance(primeTable, num_primeTable, result, num_result, 
+                            uniqueMints, num_uniqueMints, printEnabled);
+        }
+        row_done = row_dominance(primeTable, num_primeTable, result, num_result,
+            uniqueMints, num_uniqueMints, printEnabled);
+    
+        if((row_done + col_done) == 0){
+            // If the table is stuck remove the first prime implicant
+            if((*num_uniqueMints)) {
+                appendExpression(result, num_result, primeTable[0]->expr);
+                if(printEnabled) {
+                    printf("Column, Row dominance stuck removing first implicant \033[0;31m%s\033[1;0m\n", 
+                        primeTable[0]->expr);
+                    printf("remove minterms ");
+                }
+                for(i = 0; i < primeTable[0]->num_minterms; i++){
+                    if(printEnabled) {
+                        printf("%d ",primeTable[0]->minterms[i]);
+                    }
+                    removeMinterm(uniqueMints, num_uniqueMints, primeTable[0]->minterms[i]);
+                }
+                NEW_LINE(1);
+                deleteMintermSet(primeTable[0]);
+                for (i = 0; i < (*num_primeTable)-1; i++) {
+                    primeTable[i] = primeTable[i+1];
+                }
+                (*num_primeTable)--;
+            }
+            else
+                break;
+        }
+    }
+}
+
+int compareInts(const void* p, const void* q) {
+    int first = *(const int *)p, second = *(const int *)q;
+    return (first > second) - (first < second);
+}
+
+int coverEntryBefore(const CoverEntry *first, const CoverEntry *second) {
+    // More uncovered minterms first, then fewer literals, then table order
+    if (first->count != second->count)
+        return first->count > second->count;
+    if (first->dashes != second->dashes)
+        return first->dashes > second->dashes;
+    return first->prime < second->prime;
+}
+
+void pushCoverEntry(CoverEntry *heap, int *num_heap, CoverEntry entry) {
+    int i = (*num_heap)++;
+
+    while (i > 0 && coverEntryBefore(&entry, &heap[(i - 1) / 2])) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = entry;
+}
+
+CoverEntry popCoverEntry(CoverEntry *heap, int *num_heap) {
+    CoverEntry top = heap[0];
+    CoverEntry last = heap[--(*num_heap)];
+    int i = 0;
+
+    while (2 * i + 1 < (*num_heap)) {
+        int child = 2 * i + 1;
+        if (child + 1 < (*num_heap) && coverEntryBefore(&heap[child + 1], &heap[child]))
+            child++;
+        if (!coverEntryBefore(&heap[child], &last))
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+    return top;
+}
+
+int greedyCover(MintermSet **primeTable, int num_primeTable, Expression **result, int *num_result, 
+                int *uniqueMints, int num_uniqueMints, int printEnabled) {
+    int i, j, k;
+    int num_heap = 0;
+    int num_picked = 0;
+    int num_left = num_uniqueMints;
+    int *count = calloc(num_primeTable + 1, sizeof(int));
+    int *picked = malloc((num_primeTable + 1) * sizeof(int));
+    int *column_start = calloc(num_uniqueMints + 1, sizeof(int));
+    int *column_primes;
+    int *times_covered = calloc(num_uniqueMints + 1, sizeof(int));
+    CoverEntry *heap = malloc((num_primeTable + 1) * sizeof(CoverEntry));
+
+    // Minterm to prime incidence lists, don't cares have no column
+    for (i = 0; i < num_primeTable; i++) {
+        for (k = 0; k < primeTable[i]->num_minterms; k++) {
+            int *column = bsearch(&primeTable[i]->minterms[k], uniqueMints, num_uniqueMints, 
+                                  sizeof(int), compareInts);
+            if (column != NULL) {
+                column_start[column - uniqueMints + 1]++;
+                count[i]++;
+            }
+        }
+    }
+    for (j = 0; j < num_uniqueMints; j++) {
+        column_start[j + 1] += column_start[j];
+    }
+    column_primes = malloc((column_start[num_uniqueMints] + 1) * sizeof(int));
+    memcpy(times_covered, column_start, num_uniqueMints * sizeof(int));
+    for (i = 0; i < num_primeTable; i++) {
+        for (k = 0; k < primeTable[i]->num_minterms; k++) {
+            int *column = bsearch(&primeTable[i]->minterms[k], uniqueMints, num_uniqueMints, 
+                                  sizeof(int), compareInts);
+            if (column != NULL)
+                column_primes[times_covered[column - uniqueMints]++] = i;
+        }
+    }
+    memset(times_covered, 0, num_uniqueMints * sizeof(int));
+
+    for (i = 0; i < num_primeTable; i++) {
+        CoverEntry entry = {count[i], 0, i};
+        for (k = 0; primeTable[i]->binary[k] != '\0'; k++) {
+            entry.dashes += (primeTable[i]->binary[k] == '-');
+        }
+        if (entry.count > 0)
+            pushCoverEntry(heap, &num_heap, entry);
+    }
+
+    // Lazy heap, an entry whose count went stale since it was pushed goes back
+    // with the current count instead of being updated in place
+    while (num_left > 0 && num_heap > 0) {
+        CoverEntry top = popCoverEntry(heap, &num_heap);
+        MintermSet *row = primeTable[top.prime];
+
+        if (top.count != count[top.prime]) {
+            top.count = count[top.prime];
+            if (top.count > 0)
+                pushCoverEntry(heap, &num_heap, top);
+            continue;
+        }
+
+        picked[num_picked++] = top.prime;
+        if(printEnabled)
+            printf("prime implicant \033[0;31m%s\033[1;0m covers %d more minterms\n", row->expr, top.count);
+        for (k = 0; k < row->num_minterms; k++) {
+            int *column = bsearch(&row->minterms[k], uniqueMints, num_uniqueMints, sizeof(int), compareInts);
+            if (column == NULL)
+                continue;
+            j = column - uniqueMints;
+            if (times_covered[j]++ == 0) {
+                num_left--;
+                for (i = column_start[j]; i < column_start[j + 1]; i++) {
+                    count[column_primes[i]]--;
+                }
+            }
+        }
+    }
+
+    // Redundancy removal, latest picks first since they tend to add the least
+    for (i = num_picked - 1; i >= 0; i--) {
+        MintermSet *row = primeTable[picked[i]];
+        int redundant = 1;
+        for (k = 0; k < row->num_minterms && redundant; k++) {
+            int *column = bsearch(&row->minterms[k], uniqueMints, num_uniqueMints, sizeof(int), compareInts);
+            if (column != NULL && times_covered[column - uniqueMints] < 2)
+                redundant = 0;
+        }
+        if (!redundant)
+            continue;
+        for (k = 0; k < row->num_minterms; k++) {
+            int *column = bsearch(&row->minterms[k], uniqueMints, num_uniqueMints, sizeof(int), compareInts);
+            if (column != NULL)
+                times_covered[column - uniqueMints]--;
+        }
+        if(printEnabled)
+            printf("prime implicant \033[0;31m%s\033[1;0m is redundant\n", row->expr);
+        picked[i] = -1;
+    }
+    for (i = 0; i < num_picked; i++) {
+        if (picked[i] >= 0)
+            appendExpression(result, num_result, primeTable[picked[i]]->expr);
+    }
+
+    free(count);
+    free(picked);
+    free(column_start);
+    free(column_primes);
+    free(times_covered);
+    free(heap);
+    return num_left == 0;
+}
+
+void tileCoordinates(long tile, int num_blocks, int *row, int *col) {
+    // Tiles are numbered row by row over the upper triangle, so row r starts
+    // at r * num_blocks - r * (r - 1) / 2. Binary search for the row of tile
+    long low = 0, high = num_blocks - 1;
+
+    while (low < high) {
+        long mid = (low + high + 1) / 2;
+        if (mid * num_blocks - mid * (mid - 1) / 2 <= tile)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+
+    (*row) = low;
+    (*col) = low + (tile - (low * num_blocks - low * (low - 1) / 2));
+}
+
+long setBytes(int num_minterms);
+int countOnes(const char *binary);
+void appendCubeRun(CubeRun *run, const char *cube);
+
+int compareMergePairs(const void* p, const void* q) {
+    const MergePair *left = p, *right = q;
+    int order = strcmp(left->binary, right->binary);
+
+    // Ties on the pair keep the set that survives the same on every run
+    if (order == 0)
+        order = (left->first != right->first) ? left->first - right->first : left->second - right->second;
+    return order;
+}
+
 int merge_minterms(MintermSet ***groups, int *num_groups, 
                    MintermSet ***new_groups, int *num_new_groups, 
-                   MintermSet ***primeImps, int *num_primeImps, int printEnabled) {
+                   MintermSet ***primeImps, int *num_primeImps, int printEnabled, 
+                   CubeRun *spill_runs) {
 
     int i, j, k;
-    int bit_pos;
     int cant_merge = 1;
+    int spilled = 0;
     double run_time, start_time;
     // Creating a local counter for groups made a big difference in speed
     int local_num_groups = (*num_groups);
-    char temp_binary[MAX_VARS];
+    int num_blocks;
+    int num_buffers = omp_get_max_threads();
+    long t, num_tiles;
+    long num_pairs = 0;
+    MergeBuffer *buffers = calloc(num_buffers, sizeof(MergeBuffer));
+    MergePair *pairs;
+    char *binaries;
     
     start_time = omp_get_wtime();
-    // In this case schedule(dynamic) gave best results 
+    // Split the upper triangle of (i, j) pairs into MERGE_TILE x MERGE_TILE tiles.
+    // A tile only streams two cache resident blocks of sets, and equally sized
+    // tiles keep the dynamic schedule balanced where whole rows did not
+    num_blocks = (local_num_groups + MERGE_TILE - 1) / MERGE_TILE;
+    num_tiles = (long)num_blocks * (num_blocks + 1) / 2;
+
+    // Every thread appends its merges to its own buffer, nothing shared is
+    // read or locked inside the loop. Duplicates are removed after it
     #if ENABLE_MP
-        #pragma omp parallel for private(j, k, bit_pos, temp_binary) shared(cant_merge) schedule(dynamic)
+        #pragma omp parallel private(i, j)
     #endif
-    for (i = 0; i < local_num_groups - 1; i++) {
-        for (j = i + 1; j < local_num_groups; j++) {
-            bit_pos = bit_diff((*groups)[i]->binary, (*groups)[j]->binary);
-
-            if (bit_pos != 0) {
-                cant_merge = 0; // Signals that there are still groups to be merged
-                int isDuplicate = 0;
-                int local_num_ngroups = (*num_new_groups);
-
-                strcpy(temp_binary, (*groups)[i]->binary);
-                temp_binary[bit_pos] = '-';
-                
-                
-                // Check if it is duplicate
-                for (k = 0; k < local_num_ngroups; k++) {
-                    char *first_bin = (*new_groups)[k]->binary;  
-                    if (strcmp(first_bin, temp_binary) == 0) {
-                        isDuplicate = 1;
-                        break;
-                    }
-                }
-                
-               
-                if (!isDuplicate) {
-                    MintermSet *merged_set = createMintermSet();
-
-                    for (k = 0; k < (*groups)[i]->num_minterms; k++) {
-                        appendMinterm(merged_set, (*groups)[i]->minterms[k]);
-                    }
-                    for (k = 0; k < (*groups)[j]->num_minterms; k++) {
-                        appendMinterm(merged_set, (*groups)[j]->minterms[k]);
-                    }
-                    strcpy(merged_set->binary, temp_binary);
-                    
+    {
+        MergeBuffer *buffer = &buffers[omp_get_thread_num()];
+
+        // In this case schedule(dynamic) gave best results 
+        #if ENABLE_MP
+            #pragma omp for schedule(dynamic, 1)
+        #endif
+        for (t = 0; t < num_tiles; t++) {
+            int tile_row, tile_col;
+            tileCoordinates(t, num_blocks, &tile_row, &tile_col);
+            int row_start = tile_row * MERGE_TILE;
+            int col_start = tile_col * MERGE_TILE;
+            int row_end = (row_start + MERGE_TILE < local_num_groups) ? row_start + MERGE_TILE : local_num_groups;
+            int col_end = (col_start + MERGE_TILE < local_num_groups) ? col_start + MERGE_TILE : local_num_groups;
+
+            for (i = row_start; i < row_end; i++) {
+                for (j = (col_start > i) ? col_start : i + 1; j < col_end; j++) {
+                    int bit_pos = bit_diff((*groups)[i]->binary, (*groups)[j]->binary);
+                    if (bit_pos < 0)
+                        continue;
+
+                    // Whatever merges is not prime, so mark it here instead of rescanning later
                     #if ENABLE_MP
-                        #pragma omp critical
-                        {
-                            //deleteMintermSet((*new_groups)[(*num_new_groups)]); // Segfault
-                            (*new_groups)[(*num_new_groups)++] = merged_set;
-                        }
-                    #else
-                        deleteMintermSet((*new_groups)[(*num_new_groups)]);
-                        (*new_groups)[(*num_new_groups)++] = merged_set;
+                        #pragma omp atomic write
+                    #endif
+                    (*groups)[i]->isCombined = 1;
+                    #if ENABLE_MP
+                        #pragma omp atomic write
                     #endif
+                    (*groups)[j]->isCombined = 1;
+
+                    if (buffer->num_merges == buffer->max_merges) {
+                        buffer->max_merges = (buffer->max_merges > 0) ? buffer->max_merges * 2 : 256;
+                        buffer->merges = realloc(buffer->merges, buffer->max_merges * 3 * sizeof(int));
+                    }
+                    buffer->merges[buffer->num_merges * 3] = i;
+                    buffer->merges[buffer->num_merges * 3 + 1] = j;
+                    buffer->merges[buffer->num_merges * 3 + 2] = bit_pos;
+                    buffer->num_merges++;
                 }
             }
         }
     }
 
-    #if ENABLE_MP
-        int local_num_ngroups = (*num_new_groups);
-        int duplicate_found = 0;
-
-        // Sort comparing the binaries so duplicates will be next to each other 
-        qsort((*new_groups), (local_num_ngroups), sizeof(MintermSet *), compareBinary);
-
-        // Remove duplicates from the new group
-        for( i = 0; i < local_num_ngroups - 1; i++) {
-            duplicate_found = strcmp((*new_groups)[i]->binary, (*new_groups)[i+1]->binary);
-            if(!duplicate_found) {
-                // Shift elements
-                for(k = i; k < local_num_ngroups - 1; k++) 
-                    (*new_groups)[k] = (*new_groups)[k+1];
-                (*num_new_groups)--;
-                local_num_ngroups--;
-                i--;  
+    // Gather every merge with its binary, sort so duplicates are next to each
+    // other and build a set only for the first of each run
+    for (k = 0; k < num_buffers; k++) {
+        num_pairs += buffers[k].num_merges;
+    }
+    pairs = malloc((num_pairs + 1) * sizeof(MergePair));
+    binaries = malloc((num_pairs + 1) * CUBE_BYTES);
+    num_pairs = 0;
+    for (k = 0; k < num_buffers; k++) {
+        for (i = 0; i < buffers[k].num_merges; i++) {
+            int *merge = &buffers[k].merges[i * 3];
+            MergePair *pair = &pairs[num_pairs];
+            pair->binary = &binaries[num_pairs * CUBE_BYTES];
+            pair->first = merge[0];
+            pair->second = merge[1];
+            strcpy(pair->binary, (*groups)[merge[0]]->binary);
+            pair->binary[merge[2]] = '-';
+            num_pairs++;
+        }
+        free(buffers[k].merges);
+    }
+    free(buffers);
+    qsort(pairs, num_pairs, sizeof(MergePair), compareMergePairs);
+
+    // Under a memory budget a next level that would not fit goes to disk as
+    // cube runs straight from the merge records and is never built as sets
+    if (spill_runs != NULL && MEMORY_BUDGET > 0) {
+        long bytes = 0;
+        for (long p = 0; p < num_pairs; p++) {
+            if (p == 0 || strcmp(pairs[p].binary, pairs[p - 1].binary) != 0)
+                bytes += setBytes((*groups)[pairs[p].first]->num_minterms + 
+                                  (*groups)[pairs[p].second]->num_minterms);
+        }
+        if (bytes > MEMORY_BUDGET) {
+            for (k = 0; k <= CUBE_WIDTH; k++) {
+                spill_runs[k].file = NULL;
+                spill_runs[k].num_cubes = 0;
+            }
+            for (long p = 0; p < num_pairs; p++) {
+                if (p == 0 || strcmp(pairs[p].binary, pairs[p - 1].binary) != 0)
+                    appendCubeRun(&spill_runs[countOnes(pairs[p].binary)], pairs[p].binary);
             }
+            spilled = 1;
         }
+    }
 
-    #endif
+    for (long p = 0; p < num_pairs && !spilled; p++) {
+        MintermSet *first = (*groups)[pairs[p].first];
+        MintermSet *second = (*groups)[pairs[p].second];
+        if (p > 0 && strcmp(pairs[p].binary, pairs[p - 1].binary) == 0)
+            continue;
+
+        MintermSet *merged_set = createMintermSet();
+        for (k = 0; k < first->num_minterms; k++) {
+            appendMinterm(merged_set, first->minterms[k]);
+        }
+        for (k = 0; k < second->num_minterms; k++) {
+            appendMinterm(merged_set, second->minterms[k]);
+        }
+        strcpy(merged_set->binary, pairs[p].binary);
+        (*new_groups)[(*num_new_groups)++] = merged_set;
+    }
+    cant_merge = (num_pairs == 0);
+    free(pairs);
+    free(binaries);
 
-    // Find and append prime implicants
-    markPrimeImplicants((*groups), (*num_groups), (*new_groups), (*num_new_groups));
+    // Sets that never merged are the prime implicants
     for (int i = 0; i < local_num_groups; i++) {
+        (*groups)[i]->isPrimeImplicant = !(*groups)[i]->isCombined;
         if ((*groups)[i]->isPrimeImplicant) {
             MintermSet *primeImplicant = createMintermSet();
             copyMintermSet(primeImplicant, (*groups)[i]);
@@ -653,6 +1126,12 @@ int merge_minterms(MintermSet ***groups, int *num_groups,
         printf("--Merging %5d sets took %.2fs...\n", (*num_groups), (run_time - start_time));
     }
 
+    // The old level is done with, leave its slots NULL so the arrays can be reused
+    for (i = 0; i < local_num_groups; i++) {
+        deleteMintermSet((*groups)[i]);
+        (*groups)[i] = NULL;
+    }
+
     // Swap pointers to swap groups with new_groups for the next grouping
     MintermSet **temp = (*groups);
     (*groups) = (*new_groups);
@@ -661,147 +1140,825 @@ int merge_minterms(MintermSet ***groups, int *num_groups,
     // Swap their counters to reflect the change
     (*num_groups) = (*num_new_groups); 
     (*num_new_groups) = 0;
-    return cant_merge;
+    return spilled ? LEVEL_SPILLED : cant_merge;
 }
 
-void mcluskey(int *minterms, int num_minterms, int num_variables, 
-              int *donts, int num_donts, int printEnabled) {
-    int i, j;
-    int done = 0;
-    double start_time, run_time;
-    int col_done = 0;
-    int row_done = 0;
-    int num_uniqueMints = 0;
-    int uniqueMints[num_minterms];
-    int num_combined_minterms = 0;
-    int *combined_minterms;
-    int num_groups = 0;
-    int num_new_groups = 0;
-    int num_primeImps = 0;
-    MintermSet **groups =     malloc(MAX_SETS * sizeof(MintermSet *));
-    MintermSet **new_groups = malloc(MAX_SETS * sizeof(MintermSet *));
-    MintermSet **primeImps =  malloc(MAX_SETS * sizeof(MintermSet *));
-    int num_result = 0;
-    Expression *result = NULL;
-
-    if (ENABLE_MP) {
-        omp_set_num_threads(NUM_THREADS);
-        PRINT(60, '=');
-        NEW_LINE(1);
-        printf("OpenMP enabled\n");
-    } else {
-        PRINT(60, '=');
-        NEW_LINE(1);
-        printf("OpenMP disabled\n");
+void appendMintermSet(MintermSet ***list, int *num_list, MintermSet *setToAppend) {
+    // Increase size
+    MintermSet **temp = realloc(*list, ((*num_list) + 1) * sizeof(MintermSet *));
+    if(temp == NULL) {
+        printf("realloc failed at appendMintermSet\n");
+        return;
     }
+    (*list) = temp;
+    (*list)[(*num_list)++] = setToAppend;
+}
 
-    start_time = omp_get_wtime();
-    for (i = 0; i < MAX_SETS; i++) {
-        groups[i] =     NULL;
-        new_groups[i] = NULL;
-        primeImps[i] =  NULL;
+int cubeContains(const char *outer, const char *inner) {
+    for (int i = 0; outer[i] != '\0'; i++) {
+        if (outer[i] != '-' && outer[i] != inner[i])
+            return 0;
     }
+    return 1;
+}
 
-    // Check if there are don't cares and insert accordingly
-    num_combined_minterms = num_minterms + num_donts;
-    combined_minterms = malloc((num_combined_minterms) * sizeof(*combined_minterms));
-    if (donts != NULL) {
-        mergeArrays(minterms, num_minterms, donts, num_donts, 
-                    combined_minterms);
-    } else {
-        for(i = 0; i < num_minterms; i ++) {
-            combined_minterms[i] = minterms[i];
+int cubeIntersect(const char *first, const char *second, int skip_pos, char *cube) {
+    int i;
+
+    // The literal at skip_pos is dropped, the rest must agree or be a dash
+    for (i = 0; first[i] != '\0'; i++) {
+        if (i == skip_pos || first[i] == second[i] || second[i] == '-') {
+            cube[i] = first[i];
+        } else if (first[i] == '-') {
+            cube[i] = second[i];
+        } else {
+            return 0;
         }
     }
+    cube[skip_pos] = '-';
+    cube[i] = '\0';
+    return 1;
+}
 
-    for (j = 0; j < num_combined_minterms; j++) {
-        groups[j] = createMintermSet();
-        appendMinterm(groups[j], combined_minterms[j]);
-        num_groups++;
-        intToBinary(combined_minterms[j], groups[j]->binary);
+void expandCube(MintermSet *set) {
+    int i, k;
+    int LEN = strlen(set->binary);
+    int base = 0;
+    int num_dashes = 0;
+    int dash_weights[MAX_VARS];
+
+    // Fixed bits give the base minterm, every dash doubles the set
+    for (i = 0; i < LEN; i++) {
+        if (set->binary[i] == '1')
+            base += 1 << (LEN - 1 - i);
+        else if (set->binary[i] == '-')
+            dash_weights[num_dashes++] = 1 << (LEN - 1 - i);
     }
-    run_time = omp_get_wtime();
 
-    if(!printEnabled)
-        printf("Initializing minterms took %.2fs...\n", (run_time - start_time));
+    free(set->minterms);
+    set->num_minterms = 1 << num_dashes;
+    set->minterms = malloc(set->num_minterms * sizeof(*(set->minterms)));
+    for (i = 0; i < set->num_minterms; i++) {
+        int minterm = base;
+        for (k = 0; k < num_dashes; k++) {
+            if (i & (1 << k))
+                minterm += dash_weights[k];
+        }
+        set->minterms[i] = minterm;
+    }
+}
 
+int removeContainedSets(MintermSet **sets, int num_sets) {
+    int i, j;
+    int num_kept = 0;
+    char *contained = calloc(num_sets, sizeof(*contained));
 
-    start_time = omp_get_wtime();
-    // Grouping loop 
-    while (!done) {
-        done = merge_minterms(&groups, &num_groups, 
-            &new_groups, &num_new_groups, &primeImps, &num_primeImps, printEnabled);
+    // Single cube containment, of two equal cubes the first one survives
+    #if ENABLE_MP
+        #pragma omp parallel for private(j) schedule(dynamic)
+    #endif
+    for (i = 0; i < num_sets; i++) {
+        for (j = 0; j < num_sets; j++) {
+            if (j != i && cubeContains(sets[j]->binary, sets[i]->binary) && 
+                (j < i || !cubeContains(sets[i]->binary, sets[j]->binary))) {
+                contained[i] = 1;
+                break;
+            }
+        }
     }
-    free(combined_minterms);
-    run_time = omp_get_wtime();
 
-    if(!printEnabled) {
-        printf("Finding prime implicants took %.2fs...", (run_time - start_time));
-        NEW_LINE(1);
+    for (i = 0; i < num_sets; i++) {
+        if (contained[i])
+            deleteMintermSet(sets[i]);
+        else
+            sets[num_kept++] = sets[i];
     }
+    free(contained);
+    return num_kept;
+}
 
-    memset(uniqueMints, 0, num_minterms * sizeof(*uniqueMints));
-    extractUniqueMinterms(primeImps, num_primeImps, uniqueMints, &num_uniqueMints);
-    bubbleSort(uniqueMints, num_uniqueMints);
+int combineCofactors(MintermSet **zero, int num_zero, MintermSet **one, int num_one, 
+                     int pos, MintermSet ***combined) {
+    int i, j;
+    int num_combined = 0;
+    char cube[MAX_VARS + 1];
 
-    if (donts != NULL) {
-        removeDontCares(uniqueMints, &num_uniqueMints, donts, num_donts);
+    (*combined) = NULL;
+    for (i = 0; i < num_zero; i++) {
+        appendMintermSet(combined, &num_combined, zero[i]);
     }
-
-    for (i = 0; i < num_primeImps; i++) {
-        convertBinaryToExpression(primeImps[i]->binary, num_variables);
+    for (j = 0; j < num_one; j++) {
+        appendMintermSet(combined, &num_combined, one[j]);
     }
 
-    if(printEnabled) {
-        printPrimeImplicantTable(primeImps, num_primeImps, 
-            uniqueMints, num_uniqueMints);
+    // A prime spanning both halves restricts to an implicant of each one, so 
+    // it is the intersection of two cofactor primes with the split variable freed
+    for (i = 0; i < num_zero; i++) {
+        for (j = 0; j < num_one; j++) {
+            if (cubeIntersect(zero[i]->binary, one[j]->binary, pos, cube)) {
+                MintermSet *merged_set = createMintermSet();
+                strcpy(merged_set->binary, cube);
+                appendMintermSet(combined, &num_combined, merged_set);
+            }
+        }
     }
 
-    start_time = omp_get_wtime();
-    // While there are still minterms find essential prime implicants
-    col_done = 1;
-    row_done = 1;
-    while(num_uniqueMints) {
-        col_done = 1;
-        while(col_done) {
-            col_done = column_dominance(primeImps, &num_primeImps, &result, &num_result, 
-                            uniqueMints, &num_uniqueMints, printEnabled);
-        }
-        row_done = row_dominance(primeImps, &num_primeImps, &result, &num_result,
-            uniqueMints, &num_uniqueMints, printEnabled);
-        
-        if((row_done + col_done) == 0){
-            // If the table is stuck remove the first prime implicant
-            if(num_uniqueMints) {
-                appendExpression(&result, &num_result, primeImps[0]->binary);
-                if(printEnabled) {
-                    printf("Column, Row dominance stuck removing first implicant \033[0;31m%s\033[1;0m\n", 
-                        primeImps[0]->binary);
-                    printf("remove minterms ");
-                }
-                for(i = 0; i < primeImps[0]->num_minterms; i++){
-                    if(printEnabled) {
-                        printf("%d ",primeImps[0]->minterms[i]);
+    return removeContainedSets((*combined), num_combined);
+}
+
+long setBytes(int num_minterms) {
+    return sizeof(MintermSet *) + sizeof(MintermSet) + CUBE_BYTES + num_minterms * sizeof(int);
+}
+
+long levelBytes(MintermSet **groups, int num_groups) {
+    long bytes = 0;
+
+    for (int i = 0; i < num_groups; i++) {
+        bytes += setBytes(groups[i]->num_minterms);
+    }
+    return bytes;
+}
+
+int countOnes(const char *binary) {
+    int ones = 0;
+
+    for (int i = 0; binary[i] != '\0'; i++) {
+        if (binary[i] == '1')
+            ones++;
+    }
+    return ones;
+}
+
+int compareCubes(const void* p, const void* q) {
+    return strcmp((const char *)p, (const char *)q);
+}
+
+void appendCubeRun(CubeRun *run, const char *cube) {
+    if (run->file == NULL)
+        run->file = tmpfile();
+    if (run->file == NULL) {
+        printf("Error creating temporary file for a cube run\n");
+        return;
+    }
+    fwrite(cube, CUBE_BYTES, 1, run->file);
+    run->num_cubes++;
+}
+
+void writeCubeRun(CubeRun *run, char *cubes, int num_cubes) {
+    // One chunk of a run, duplicates across chunks go when the run is read
+    qsort(cubes, num_cubes, CUBE_BYTES, compareCubes);
+    for (int i = 0; i < num_cubes; i++) {
+        if (i > 0 && !strcmp(&cubes[i * CUBE_BYTES], &cubes[(i - 1) * CUBE_BYTES]))
+            continue;
+        appendCubeRun(run, &cubes[i * CUBE_BYTES]);
+    }
+}
+
+char *readCubeRun(CubeRun *run) {
+    int i, num_unique = 0;
+    char *cubes = malloc((run->num_cubes + 1) * CUBE_BYTES);
+
+    if (run->file == NULL) {
+        run->num_cubes = 0;
+        return cubes;
+    }
+    rewind(run->file);
+    if (fread(cubes, CUBE_BYTES, run->num_cubes, run->file) != (size_t)run->num_cubes) {
+        printf("Error reading a cube run back\n");
+        run->num_cubes = 0;
+    }
+    fclose(run->file);
+    run->file = NULL;
+
+    // Sorted and duplicate free, like the deduplicated in-memory levels
+    qsort(cubes, run->num_cubes, CUBE_BYTES, compareCubes);
+    for (i = 0; i < run->num_cubes; i++) {
+        if (i > 0 && !strcmp(&cubes[i * CUBE_BYTES], &cubes[(num_unique - 1) * CUBE_BYTES]))
+            continue;
+        memmove(&cubes[num_unique++ * CUBE_BYTES], &cubes[i * CUBE_BYTES], CUBE_BYTES);
+    }
+    run->num_cubes = num_unique;
+    return cubes;
+}
+
+void spillLevel(MintermSet **groups, int num_groups, CubeRun *runs) {
+    int i;
+
+    // Bucket by number of ones, only neighbouring buckets can merge
+    for (i = 0; i <= CUBE_WIDTH; i++) {
+        runs[i].file = NULL;
+        runs[i].num_cubes = 0;
+    }
+    for (i = 0; i < num_groups; i++) {
+        appendCubeRun(&runs[countOnes(groups[i]->binary)], groups[i]->binary);
+        deleteMintermSet(groups[i]);
+        groups[i] = NULL;
+    }
+}
+
+int mergeCubeRuns(CubeRun *runs, CubeRun *new_runs, 
+                  MintermSet **primeImps, int *num_primeImps) {
+    int i, j, b;
+    int bit_pos;
+    int cant_merge = 1;
+    char *low = readCubeRun(&runs[0]);
+    int num_low = runs[0].num_cubes;
+    int num_high;
+    char *high;
+    char *low_combined = calloc(num_low + 1, sizeof(char));
+    char *high_combined;
+    // Merged cubes go to disk in chunks of a quarter of the budget
+    long max_merged = (MEMORY_BUDGET / 4 / CUBE_BYTES > 1024) ? MEMORY_BUDGET / 4 / CUBE_BYTES : 1024;
+    char *merged = malloc(max_merged * CUBE_BYTES);
+
+    // Stream through the buckets, holding only bucket b and b + 1 in memory
+    for (b = 0; b <= CUBE_WIDTH; b++) {
+        long num_merged = 0;
+
+        new_runs[b].file = NULL;
+        new_runs[b].num_cubes = 0;
+        high = (b < CUBE_WIDTH) ? readCubeRun(&runs[b + 1]) : malloc(CUBE_BYTES);
+        num_high = (b < CUBE_WIDTH) ? runs[b + 1].num_cubes : 0;
+        high_combined = calloc(num_high + 1, sizeof(char));
+
+        #if ENABLE_MP
+            #pragma omp parallel for private(j, bit_pos) shared(cant_merge) schedule(dynamic)
+        #endif
+        for (i = 0; i < num_low; i++) {
+            for (j = 0; j < num_high; j++) {
+                bit_pos = bit_diff(&low[i * CUBE_BYTES], &high[j * CUBE_BYTES]);
+
+                if (bit_pos >= 0) {
+                    cant_merge = 0;
+                    low_combined[i] = 1;
+                    #if ENABLE_MP
+                        #pragma omp atomic write
+                    #endif
+                    high_combined[j] = 1;
+                    #if ENABLE_MP
+                        #pragma omp critical
+                    #endif
+                    {
+                        if (num_merged == max_merged) {
+                            writeCubeRun(&new_runs[b], merged, num_merged);
+                            num_merged = 0;
+                        }
+                        memcpy(&merged[num_merged * CUBE_BYTES], &low[i * CUBE_BYTES], CUBE_BYTES);
+                        merged[num_merged++ * CUBE_BYTES + bit_pos] = '-';
                     }
-                    removeMinterm(uniqueMints, &num_uniqueMints, primeImps[0]->minterms[i]);
-                }
-                NEW_LINE(1);
-                deleteMintermSet(primeImps[0]);
-                for (i = 0; i < num_primeImps-1; i++) {
-                    primeImps[i] = primeImps[i+1];
                 }
-                num_primeImps--;
             }
-            else
+        }
+
+        // Bucket b has now met both of its neighbours, what never merged is prime
+        for (i = 0; i < num_low; i++) {
+            if (low_combined[i])
+                continue;
+            if ((*num_primeImps) >= MAX_SETS) {
+                printf("More than MAX_SETS prime implicants, dropping the rest\n");
                 break;
+            }
+            MintermSet *primeImplicant = createMintermSet();
+            strcpy(primeImplicant->binary, &low[i * CUBE_BYTES]);
+            expandCube(primeImplicant);
+            primeImplicant->isPrimeImplicant = 1;
+            primeImps[(*num_primeImps)++] = primeImplicant;
         }
+
+        writeCubeRun(&new_runs[b], merged, num_merged);
+        free(low);
+        free(low_combined);
+        low = high;
+        low_combined = high_combined;
+        num_low = num_high;
+    }
+    free(low);
+    free(low_combined);
+    free(merged);
+    return cant_merge;
+}
+
+int findPrimeImplicantsOutOfCore(CubeRun *runs, MintermSet **primeImps, int *num_primeImps) {
+    int b;
+    int done = 0;
+    int num_groups = 0;
+    double start_time, run_time;
+    CubeRun new_runs[MAX_VARS + 1];
+
+    for (b = 0; b <= CUBE_WIDTH; b++) {
+        num_groups += runs[b].num_cubes;
+    }
+    while (!done) {
+        start_time = omp_get_wtime();
+        done = mergeCubeRuns(runs, new_runs, primeImps, num_primeImps);
+        run_time = omp_get_wtime();
+        printf("--Merging %5d sets out of core took %.2fs...\n", num_groups, (run_time - start_time));
+
+        num_groups = 0;
+        for (b = 0; b <= CUBE_WIDTH; b++) {
+            runs[b] = new_runs[b];
+            num_groups += runs[b].num_cubes;
+        }
+    }
+
+    for (b = 0; b <= CUBE_WIDTH; b++) {
+        if (runs[b].file != NULL)
+            fclose(runs[b].file);
+    }
+    return done;
+}
+
+int findPrimeImplicants(int *combined_minterms, int num_combined_minterms, 
+                        MintermSet **primeImps, int printEnabled) {
+    int i;
+    int done = 0;
+    double start_time, run_time;
+    int num_groups = 0;
+    int num_new_groups = 0;
+    int num_primeImps = 0;
+    MintermSet **groups =     arenaSets(&GROUPS_ARENA);
+    MintermSet **new_groups = arenaSets(&NEW_GROUPS_ARENA);
+    CubeRun runs[MAX_VARS + 1];
+
+    start_time = omp_get_wtime();
+
+    for (i = 0; i < num_combined_minterms; i++) {
+        groups[i] = createMintermSet();
+        appendMinterm(groups[i], combined_minterms[i]);
+        num_groups++;
+        intToBinary(combined_minterms[i], groups[i]->binary);
+    }
+    run_time = omp_get_wtime();
+
+    if(!printEnabled)
+        printf("Initializing minterms took %.2fs...\n", (run_time - start_time));
+
+    // Grouping loop, a level over the memory budget continues on disk. Only
+    // the minterms can be over here, later levels are spilled while built
+    while (!done) {
+        if (MEMORY_BUDGET > 0 && levelBytes(groups, num_groups) > MEMORY_BUDGET) {
+            spillLevel(groups, num_groups, runs);
+            num_groups = 0;
+            done = findPrimeImplicantsOutOfCore(runs, primeImps, &num_primeImps);
+            break;
+        }
+        done = merge_minterms(&groups, &num_groups, &new_groups, &num_new_groups, 
+            &primeImps, &num_primeImps, printEnabled, (MEMORY_BUDGET > 0) ? runs : NULL);
+        if (done == LEVEL_SPILLED)
+            done = findPrimeImplicantsOutOfCore(runs, primeImps, &num_primeImps);
+    }
+
+    // Every level frees the one before it, only the last one can be left
+    releaseSets(groups, num_groups, num_groups);
+    return num_primeImps;
+}
+
+pid_t startShardWorker(FILE **request, FILE **response) {
+    int to_worker[2], from_worker[2];
+    pid_t pid;
+
+    if (pipe(to_worker) != 0) {
+        printf("Error creating pipe for shard worker\n");
+        return -1;
+    }
+    if (pipe(from_worker) != 0) {
+        printf("Error creating pipe for shard worker\n");
+        close(to_worker[0]);
+        close(to_worker[1]);
+        return -1;
+    }
+    // Later workers must not inherit the pipes of earlier ones
+    fcntl(to_worker[1], F_SETFD, FD_CLOEXEC);
+    fcntl(from_worker[0], F_SETFD, FD_CLOEXEC);
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+        dup2(to_worker[0], STDIN_FILENO);
+        dup2(from_worker[1], STDOUT_FILENO);
+        close(to_worker[0]);
+        close(to_worker[1]);
+        close(from_worker[0]);
+        close(from_worker[1]);
+        execl(SHARD_WORKER_CMD, SHARD_WORKER_CMD, "worker", (char *)NULL);
+        _exit(127);
+    }
+
+    close(to_worker[0]);
+    close(from_worker[1]);
+    if (pid < 0) {
+        printf("Error forking shard worker\n");
+        close(to_worker[1]);
+        close(from_worker[0]);
+        return -1;
+    }
+    (*request) = fdopen(to_worker[1], "w");
+    (*response) = fdopen(from_worker[0], "r");
+    return pid;
+}
+
+int sendShardRequest(FILE *request, int num_variables, int num_threads, long budget_kb, 
+                     int *minterms, int num_minterms) {
+    int failed = 0;
+
+    // A worker that already exited shows up as a write or close error, not a signal
+    failed |= fprintf(request, "%d %d %ld %d\n", num_variables, num_threads, budget_kb, num_minterms) < 0;
+    for (int i = 0; i < num_minterms && !failed; i++) {
+        failed |= fprintf(request, "%d ", minterms[i]) < 0;
+    }
+    failed |= fprintf(request, "\n") < 0;
+    failed |= fclose(request) != 0;
+    return failed ? -1 : 0;
+}
+
+int readShardResponse(FILE *response, int num_variables, MintermSet ***primes) {
+    int i, num_primes;
+    int num_read = 0;
+    char line[MAX_VARS + 3];
+
+    (*primes) = NULL;
+    if (fscanf(response, "%d ", &num_primes) != 1 || num_primes < 0)
+        return -1;
+
+    for (i = 0; i < num_primes; i++) {
+        if (fgets(line, sizeof(line), response) == NULL)
+            break;
+        line[strcspn(line, "\n")] = '\0';
+        if ((int)strlen(line) != num_variables)
+            break;
+        MintermSet *prime = createMintermSet();
+        strcpy(prime->binary, line);
+        appendMintermSet(primes, &num_read, prime);
+    }
+
+    if (num_read != num_primes) {
+        deleteMintermSets((*primes), num_read);
+        (*primes) = NULL;
+        return -1;
+    }
+    return num_primes;
+}
+
+int shardWorker(void) {
+    int i;
+    int num_variables, num_threads, num_minterms, num_primeImps;
+    long budget_kb;
+    int *minterms;
+    MintermSet **primeImps;
+    FILE *response;
+
+    // Request: "<num_variables> <num_threads> <budget_kb> <num_minterms>" and the minterms
+    if (scanf("%d %d %ld %d", &num_variables, &num_threads, &budget_kb, &num_minterms) != 4 || 
+        num_variables < 1 || num_variables > MAX_MINTERM_VARS || budget_kb < 0 || num_minterms < 0) {
+        fprintf(stderr, "Malformed shard request\n");
+        return 1;
+    }
+    minterms = malloc((num_minterms + 1) * sizeof(*minterms));
+    for (i = 0; i < num_minterms; i++) {
+        if (scanf("%d", &minterms[i]) != 1) {
+            fprintf(stderr, "Malformed shard request\n");
+            free(minterms);
+            return 1;
+        }
+    }
+
+    // Keep the response stream clean of the progress output
+    response = fdopen(dup(STDOUT_FILENO), "w");
+    freopen("/dev/null", "w", stdout);
+
+    if (ENABLE_MP)
+        omp_set_num_threads(num_threads);
+    MEMORY_BUDGET = budget_kb * 1024;
+    selectCubeWidth(num_variables);
+    primeImps = malloc(MAX_SETS * sizeof(MintermSet *));
+    for (i = 0; i < MAX_SETS; i++) {
+        primeImps[i] = NULL;
+    }
+    num_primeImps = findPrimeImplicants(minterms, num_minterms, primeImps, 0);
+
+    // Response: "<num_primes>" and one cube per line over num_variables
+    fprintf(response, "%d\n", num_primeImps);
+    for (i = 0; i < num_primeImps; i++) {
+        fprintf(response, "%s\n", primeImps[i]->binary + (CUBE_WIDTH - num_variables));
+    }
+    fclose(response);
+
+    deleteMintermSets(primeImps, num_primeImps);
+    free(minterms);
+    return 0;
+}
+
+int findPrimeImplicantsSharded(int *combined_minterms, int num_combined_minterms, 
+                               int num_variables, int num_shard_vars, 
+                               MintermSet **primeImps, int printEnabled) {
+    int i, s, v;
+    int num_shards = 1 << num_shard_vars;
+    int sub_variables = num_variables - num_shard_vars;
+    int sub_mask = (1 << sub_variables) - 1;
+    int start = CUBE_WIDTH - num_variables;
+    int num_workers = (num_shards < MAX_SHARD_WORKERS) ? num_shards : MAX_SHARD_WORKERS;
+    int num_threads = (NUM_THREADS / num_workers > 0) ? NUM_THREADS / num_workers : 1;
+    // Workers that run together share the budget
+    long budget_kb = MEMORY_BUDGET / num_workers / 1024;
+    int num_primeImps = 0;
+    int next_shard = 0, num_running = 0;
+    void (*old_sigpipe)(int) = signal(SIGPIPE, SIG_IGN);
+    int *num_shard_minterms = calloc(num_shards, sizeof(int));
+    int **shard_minterms = calloc(num_shards, sizeof(int *));
+    int *num_shard_primes = calloc(num_shards, sizeof(int));
+    MintermSet ***shard_primes = calloc(num_shards, sizeof(MintermSet **));
+    FILE **requests = calloc(num_shards, sizeof(FILE *));
+    FILE **responses = calloc(num_shards, sizeof(FILE *));
+    pid_t *pids = calloc(num_shards, sizeof(pid_t));
+
+    // Cofactor on the top variables, each shard keeps the remaining low bits
+    for (i = 0; i < num_combined_minterms; i++) {
+        s = combined_minterms[i] >> sub_variables;
+        if (s < 0 || s >= num_shards)
+            continue;
+        shard_minterms[s] = realloc(shard_minterms[s], (num_shard_minterms[s] + 1) * sizeof(int));
+        shard_minterms[s][num_shard_minterms[s]++] = combined_minterms[i] & sub_mask;
+    }
+
+    for (s = 0; s < num_shards; s++) {
+        // Keep up to MAX_SHARD_WORKERS running, a new one starts as the oldest is collected
+        while (next_shard < num_shards && (next_shard <= s || num_running < MAX_SHARD_WORKERS)) {
+            int n = next_shard++;
+            pids[n] = 0;
+            if (num_shard_minterms[n] == 0)
+                continue;
+            pids[n] = startShardWorker(&requests[n], &responses[n]);
+            if (pids[n] <= 0)
+                continue;
+            if (sendShardRequest(requests[n], sub_variables, num_threads, budget_kb, 
+                                 shard_minterms[n], num_shard_minterms[n]) != 0) {
+                kill(pids[n], SIGKILL);
+                waitpid(pids[n], NULL, 0);
+                fclose(responses[n]);
+                pids[n] = -1;
+                continue;
+            }
+            num_running++;
+        }
+
+        if (num_shard_minterms[s] == 0)
+            continue;
+        num_shard_primes[s] = -1;
+        if (pids[s] > 0) {
+            int status;
+            num_running--;
+            num_shard_primes[s] = readShardResponse(responses[s], sub_variables, &shard_primes[s]);
+            fclose(responses[s]);
+            waitpid(pids[s], &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                deleteMintermSets(shard_primes[s], (num_shard_primes[s] > 0) ? num_shard_primes[s] : 0);
+                shard_primes[s] = NULL;
+                num_shard_primes[s] = -1;
+            }
+        }
+
+        // A lost worker should not lose the result, redo its shard here
+        if (num_shard_primes[s] < 0) {
+            MintermSet **local_primes = malloc(MAX_SETS * sizeof(MintermSet *));
+            printf("Shard worker %d failed, minimizing it locally\n", s);
+            for (i = 0; i < MAX_SETS; i++) {
+                local_primes[i] = NULL;
+            }
+            num_shard_primes[s] = findPrimeImplicants(shard_minterms[s], num_shard_minterms[s], 
+                                                      local_primes, printEnabled);
+            shard_primes[s] = NULL;
+            for (i = 0; i < num_shard_primes[s]; i++) {
+                memmove(local_primes[i]->binary, local_primes[i]->binary + start + num_shard_vars, 
+                        sub_variables + 1);
+                free(local_primes[i]->minterms);
+                local_primes[i]->minterms = NULL;
+                local_primes[i]->num_minterms = 0;
+            }
+            shard_primes[s] = local_primes;
+        }
+
+        // Put the splitting literals back in front of every cube
+        for (i = 0; i < num_shard_primes[s]; i++) {
+            char *binary = shard_primes[s][i]->binary;
+            memmove(binary + start + num_shard_vars, binary, sub_variables + 1);
+            memset(binary, '0', start);
+            for (v = 0; v < num_shard_vars; v++) {
+                binary[start + v] = ((s >> (num_shard_vars - 1 - v)) & 1) + '0';
+            }
+        }
+        if(!printEnabled)
+            printf("--Shard %3d: %5d minterms gave %5d primes\n", s, num_shard_minterms[s], num_shard_primes[s]);
+    }
+
+    // Merge sibling shards one split variable at a time, innermost first
+    for (v = 0; v < num_shard_vars; v++) {
+        int pos = start + num_shard_vars - 1 - v;
+        for (s = 0; s < num_shards; s += (2 << v)) {
+            int sibling = s + (1 << v);
+            MintermSet **combined;
+            num_shard_primes[s] = combineCofactors(shard_primes[s], num_shard_primes[s], 
+                                      shard_primes[sibling], num_shard_primes[sibling], pos, &combined);
+            free(shard_primes[s]);
+            free(shard_primes[sibling]);
+            shard_primes[s] = combined;
+            shard_primes[sibling] = NULL;
+            num_shard_primes[sibling] = 0;
+        }
+    }
+
+    for (i = 0; i < num_shard_primes[0]; i++) {
+        if (num_primeImps >= MAX_SETS) {
+            printf("More than MAX_SETS prime implicants, dropping the rest\n");
+            deleteMintermSet(shard_primes[0][i]);
+            continue;
+        }
+        expandCube(shard_primes[0][i]);
+        shard_primes[0][i]->isPrimeImplicant = 1;
+        primeImps[num_primeImps++] = shard_primes[0][i];
+    }
+    if(printEnabled) {
+        print_groups(primeImps, num_primeImps);
+    }
+
+    free(shard_primes[0]);
+    for (s = 0; s < num_shards; s++) {
+        free(shard_minterms[s]);
+    }
+    free(shard_minterms);
+    free(num_shard_minterms);
+    free(shard_primes);
+    free(num_shard_primes);
+    free(requests);
+    free(responses);
+    free(pids);
+    signal(SIGPIPE, old_sigpipe);
+    return num_primeImps;
+}
+
+int chooseForm(int num_minterms, int num_donts, int num_variables, int form) {
+    long num_offset = (1L << num_variables) - num_minterms - num_donts;
+    double density = (double)(num_minterms + num_donts) / (1L << num_variables);
+
+    // Dense is not enough, don't cares can make a small on-set dense. Only go
+    // through the off-set when it really is the smaller of the two
+    if (form == FORM_AUTO)
+        form = (density > DENSITY_THRESHOLD && num_offset < num_minterms) ? FORM_POS : FORM_SOP;
+    return form;
+}
+
+long countInputSets(int num_minterms, int num_donts, int num_variables, int form) {
+    // Sets the prime search starts from. For POS that is the off-set plus the
+    // don't cares, so everything but the minterms. Duplicate minterms only
+    // make the real count bigger
+    if (form == FORM_POS)
+        return (1L << num_variables) - num_minterms;
+    return (long)num_minterms + num_donts;
+}
+
+void mcluskey(int *minterms, int num_minterms, int num_variables, 
+              int *donts, int num_donts, int printEnabled, char **cover) {
+    int i;
+    double start_time, run_time;
+    int num_uniqueMints = 0;
+    int *uniqueMints;
+    int num_combined_minterms = 0;
+    int *combined_minterms;
+    int num_primeImps = 0;
+    int num_found = 0;
+    MintermSet **primeImps;
+    int num_result = 0;
+    Expression *result = NULL;
+    int form = OUTPUT_FORM;
+    int num_offset = 0;
+    int *offset = NULL;
+    char expr[EXPR_LEN(MAX_VARS)];
+
+    if (ENABLE_MP) {
+        omp_set_num_threads(NUM_THREADS);
+        PRINT(60, '=');
+        NEW_LINE(1);
+        printf("OpenMP enabled\n");
+    } else {
+        PRINT(60, '=');
+        NEW_LINE(1);
+        printf("OpenMP disabled\n");
+    }
+    if (cover != NULL)
+        (*cover) = NULL;
+
+    if (num_variables < 1 || num_variables > MAX_MINTERM_VARS) {
+        printf("Minterm input supports 1 to %d variables\n", MAX_MINTERM_VARS);
+        return;
+    }
+    selectCubeWidth(num_variables);
+
+    // A dense on-set has far fewer maxterms than minterms, so minimize F' and
+    // report it as a product of sums. FORM_POS always goes through the off-set
+    double density = (double)(num_minterms + num_donts) / (1L << num_variables);
+    form = chooseForm(num_minterms, num_donts, num_variables, form);
+    if (countInputSets(num_minterms, num_donts, num_variables, form) > MAX_SETS) {
+        printf("%s needs %ld sets, more than MAX_SETS (%d)\n", (form == FORM_POS) ? "POS" : "SOP", 
+               countInputSets(num_minterms, num_donts, num_variables, form), MAX_SETS);
+        return;
+    }
+    if (form == FORM_POS) {
+        start_time = omp_get_wtime();
+        offset = complementMinterms(minterms, num_minterms, donts, num_donts, 
+                                    num_variables, &num_offset);
+        if (offset == NULL)
+            return;
+        if ((long)num_offset + num_donts > MAX_SETS) {
+            printf("POS needs %ld sets, more than MAX_SETS (%d)\n", (long)num_offset + num_donts, MAX_SETS);
+            free(offset);
+            return;
+        }
+        minterms = offset;
+        num_minterms = num_offset;
+        run_time = omp_get_wtime();
+        printf("On-set density %.2f, minimizing %d maxterms for POS\n", density, num_offset);
+        if(!printEnabled)
+            printf("Complementing minterms took %.2fs...\n", (run_time - start_time));
+    }
+
+    // Constant function, nothing to minimize
+    if (num_minterms == 0) {
+        appendExpression(&result, &num_result, (form == FORM_POS) ? "1" : "0");
+        printExpression(result, num_result, FORM_SOP);
+        PRINT(60, '=');
+        NEW_LINE(1);
+        if (cover != NULL)
+            (*cover) = joinExpression(result, num_result, FORM_SOP);
+        deleteExpression(result, num_result);
+        free(offset);
+        return;
+    }
+
+    primeImps = arenaSets(&PRIMES_ARENA);
+    uniqueMints = malloc((num_minterms + num_donts) * sizeof(*uniqueMints));
+
+    // Check if there are don't cares and insert accordingly
+    num_combined_minterms = num_minterms + num_donts;
+    combined_minterms = malloc((num_combined_minterms) * sizeof(*combined_minterms));
+    if (donts != NULL) {
+        mergeArrays(minterms, num_minterms, donts, num_donts, 
+                    combined_minterms);
+    } else {
+        for(i = 0; i < num_minterms; i ++) {
+            combined_minterms[i] = minterms[i];
+        }
+    }
+
+    start_time = omp_get_wtime();
+    if (NUM_SHARD_VARS > 0 && NUM_SHARD_VARS < num_variables) {
+        num_primeImps = findPrimeImplicantsSharded(combined_minterms, num_combined_minterms, 
+                            num_variables, NUM_SHARD_VARS, primeImps, printEnabled);
+    } else {
+        num_primeImps = findPrimeImplicants(combined_minterms, num_combined_minterms, 
+                            primeImps, printEnabled);
+    }
+    free(combined_minterms);
+    num_found = num_primeImps;
+    run_time = omp_get_wtime();
+
+    if(!printEnabled) {
+        printf("Finding prime implicants took %.2fs...", (run_time - start_time));
+        NEW_LINE(1);
+    }
+
+    memset(uniqueMints, 0, (num_minterms + num_donts) * sizeof(*uniqueMints));
+    extractUniqueMinterms(primeImps, num_primeImps, uniqueMints, &num_uniqueMints);
+    qsort(uniqueMints, num_uniqueMints, sizeof(int), compareInts);
+
+    if (donts != NULL) {
+        removeDontCares(uniqueMints, &num_uniqueMints, donts, num_donts);
+    }
+
+    for (i = 0; i < num_primeImps; i++) {
+        convertBinaryToExpression(primeImps[i]->binary, num_variables, form, expr);
+        primeImps[i]->expr = malloc((strlen(expr) + 1) * sizeof(char));
+        strcpy(primeImps[i]->expr, expr);
+    }
+
+    if(printEnabled) {
+        printPrimeImplicantTable(primeImps, num_primeImps, 
+            uniqueMints, num_uniqueMints);
+    }
+
+    start_time = omp_get_wtime();
+    // Greedy trades the minimum for O(coverage log primes) on very large charts
+    if (COVER_MODE == COVER_GREEDY) {
+        greedyCover(primeImps, num_primeImps, &result, &num_result, 
+                    uniqueMints, num_uniqueMints, printEnabled);
+    } else {
+        exactCover(primeImps, &num_primeImps, &result, &num_result, 
+                   uniqueMints, &num_uniqueMints, printEnabled);
     }
 
     run_time = omp_get_wtime();
     if(!printEnabled)
         printf("Finding essential implicants took %.2fs...\n", (run_time - start_time));
     else{
-        printExpression(result, num_result);
+        printExpression(result, num_result, form);
     }
     PRINT(60, '=');
     NEW_LINE(1);
@@ -809,18 +1966,764 @@ void mcluskey(int *minterms, int num_minterms, int num_variables,
     // Reset print counters
     NUM_GROUP_PRINTS = 0;
     NUM_TABLE_PRINTS = 0;
+    if (cover != NULL)
+        (*cover) = joinExpression(result, num_result, form);
     // Free memory used by MintermSets and Expression
     deleteExpression(result, num_result);
-    #if(!ENABLE_MP)
-        deleteMintermSets(groups, MAX_SETS);        // When OpenMP=enabled this causes a segfault 
-        deleteMintermSets(new_groups, MAX_SETS);    // When OpenMP=enabled this causes a segfault
-    #endif
-    deleteMintermSets(primeImps, num_primeImps);  
+    releaseSets(primeImps, num_primeImps, num_found);
+    free(uniqueMints);
+    free(offset);
+}
+
+void packCube(const char *binary, uint64_t *cube, int num_words) {
+    int i;
+
+    // Variables past the end stay dashes so they never empty a cube
+    for (i = 0; i < num_words; i++) {
+        cube[i] = ~0ULL;
+    }
+    for (i = 0; binary[i] != '\0'; i++) {
+        uint64_t field = (binary[i] == '0') ? 1 : (binary[i] == '1') ? 2 : 3;
+        cube[i / 32] &= ~(3ULL << ((i % 32) * 2));
+        cube[i / 32] |= field << ((i % 32) * 2);
+    }
+}
+
+void unpackCube(const uint64_t *cube, int num_variables, char *binary) {
+    const char symbols[] = {'?', '0', '1', '-'};
+
+    for (int i = 0; i < num_variables; i++) {
+        binary[i] = symbols[(cube[i / 32] >> ((i % 32) * 2)) & 3];
+    }
+    binary[num_variables] = '\0';
+}
+
+int conflictingFields(const uint64_t *first, const uint64_t *second, int num_words) {
+    int conflicts = 0;
+
+    // A 00 field in the intersection is a variable the two cubes disagree on
+    for (int i = 0; i < num_words; i++) {
+        uint64_t both = first[i] & second[i];
+        conflicts += __builtin_popcountll(~(both | (both >> 1)) & FIELD_LOW_BITS);
+    }
+    return conflicts;
+}
+
+int packedContains(const uint64_t *outer, const uint64_t *inner, int num_words) {
+    for (int i = 0; i < num_words; i++) {
+        if (inner[i] & ~outer[i])
+            return 0;
+    }
+    return 1;
+}
+
+void consensusCube(const uint64_t *first, const uint64_t *second, uint64_t *cube, int num_words) {
+    // Intersection with the one conflicting variable freed
+    for (int i = 0; i < num_words; i++) {
+        uint64_t both = first[i] & second[i];
+        uint64_t conflict = ~(both | (both >> 1)) & FIELD_LOW_BITS;
+        cube[i] = both | conflict | (conflict << 1);
+    }
+}
+
+int appendPackedCube(PackedCover *cover, const uint64_t *cube) {
+    if (cover->num_cubes == cover->max_cubes) {
+        int max_cubes = (cover->max_cubes > 0) ? cover->max_cubes * 2 : 64;
+        uint64_t *temp = realloc(cover->cubes, (size_t)max_cubes * cover->num_words * sizeof(uint64_t));
+        if (temp == NULL) {
+            printf("realloc failed at appendPackedCube\n");
+            return -1;
+        }
+        cover->cubes = temp;
+        cover->max_cubes = max_cubes;
+    }
+    memcpy(&cover->cubes[(size_t)cover->num_cubes * cover->num_words], cube, 
+           cover->num_words * sizeof(uint64_t));
+    cover->num_cubes++;
+    return 0;
+}
+
+void compactPackedCover(PackedCover *cover, char *removed) {
+    int num_kept = 0;
+
+    for (int i = 0; i < cover->num_cubes; i++) {
+        if (removed[i])
+            continue;
+        memmove(&cover->cubes[(size_t)num_kept * cover->num_words], 
+                &cover->cubes[(size_t)i * cover->num_words], cover->num_words * sizeof(uint64_t));
+        num_kept++;
+    }
+    cover->num_cubes = num_kept;
+}
+
+void generatePrimesByConsensus(PackedCover *cover) {
+    int i, j, k;
+    int num_words = cover->num_words;
+    int failed = 0;
+    int max_removed = cover->num_cubes + 1;
+    uint64_t cube[CUBE_WORDS];
+    char *removed = calloc(max_removed, sizeof(char));
+
+    // Single cube containment on the input first
+    for (i = 0; i < cover->num_cubes; i++) {
+        for (j = 0; j < cover->num_cubes && !removed[i]; j++) {
+            if (j != i && !removed[j] && 
+                packedContains(&cover->cubes[(size_t)j * num_words], &cover->cubes[(size_t)i * num_words], num_words))
+                removed[i] = 1;
+        }
+    }
+
+    // Add consensus cubes nothing contains yet. New cubes go on the end and
+    // the i loop runs up to the current end, so every new cube later meets
+    // every cube before it and each pair is tried exactly once. A pair with a
+    // removed cube can be skipped, its consensus is inside the container's
+    for (i = 1; i < cover->num_cubes && !failed; i++) {
+        for (j = 0; j < i && !removed[i] && !failed; j++) {
+            uint64_t *first = &cover->cubes[(size_t)i * num_words];
+            uint64_t *second = &cover->cubes[(size_t)j * num_words];
+            if (removed[j] || conflictingFields(first, second, num_words) != 1)
+                continue;
+
+            consensusCube(first, second, cube, num_words);
+            for (k = 0; k < cover->num_cubes; k++) {
+                if (!removed[k] && packedContains(&cover->cubes[(size_t)k * num_words], cube, num_words))
+                    break;
+            }
+            if (k < cover->num_cubes)
+                continue;
+
+            // Whatever the new cube contains can go
+            for (k = 0; k < cover->num_cubes; k++) {
+                if (!removed[k] && packedContains(cube, &cover->cubes[(size_t)k * num_words], num_words))
+                    removed[k] = 1;
+            }
+            if (appendPackedCube(cover, cube) != 0) {
+                failed = 1;
+                break;
+            }
+            if (cover->num_cubes > max_removed) {
+                char *temp = realloc(removed, cover->max_cubes);
+                if (temp == NULL) {
+                    printf("realloc failed at generatePrimesByConsensus\n");
+                    cover->num_cubes--;
+                    failed = 1;
+                    break;
+                }
+                removed = temp;
+                max_removed = cover->max_cubes;
+            }
+            removed[cover->num_cubes - 1] = 0;
+        }
+    }
+    if (failed)
+        printf("Out of memory, the prime implicants are incomplete\n");
+
+    compactPackedCover(cover, removed);
+    free(removed);
+}
+
+int isTautology(uint64_t *cubes, int num_cubes, int num_words, int num_variables) {
+    int i, v;
+    int split = -1;
+    int most_binate = 0;
+    int result;
+    uint64_t *cofactor;
+
+    if (num_cubes == 0)
+        return 0;
+
+    // A universal cube makes it a tautology, otherwise split on the most binate variable
+    for (i = 0; i < num_cubes; i++) {
+        int universal = 1;
+        for (int w = 0; w < num_words && universal; w++) {
+            universal = (cubes[(size_t)i * num_words + w] == ~0ULL);
+        }
+        if (universal)
+            return 1;
+    }
+    for (v = 0; v < num_variables; v++) {
+        int zeros = 0, ones = 0;
+        for (i = 0; i < num_cubes; i++) {
+            uint64_t field = (cubes[(size_t)i * num_words + v / 32] >> ((v % 32) * 2)) & 3;
+            zeros += (field == 1);
+            ones += (field == 2);
+        }
+        if (zeros && ones && zeros + ones > most_binate) {
+            most_binate = zeros + ones;
+            split = v;
+        }
+    }
+    // A unate cover without the universal cube misses the all-dash corner it avoids
+    if (split < 0)
+        return 0;
+
+    cofactor = malloc((size_t)num_cubes * num_words * sizeof(uint64_t));
+    result = 1;
+    for (uint64_t side = 1; side <= 2 && result; side++) {
+        int num_cofactor = 0;
+        for (i = 0; i < num_cubes; i++) {
+            uint64_t *cube = &cubes[(size_t)i * num_words];
+            uint64_t field = (cube[split / 32] >> ((split % 32) * 2)) & 3;
+            if (!(field & side))
+                continue;
+            memcpy(&cofactor[(size_t)num_cofactor * num_words], cube, num_words * sizeof(uint64_t));
+            cofactor[(size_t)num_cofactor * num_words + split / 32] |= 3ULL << ((split % 32) * 2);
+            num_cofactor++;
+        }
+        result = isTautology(cofactor, num_cofactor, num_words, num_variables);
+    }
+    free(cofactor);
+    return result;
+}
+
+int coveredByOthers(PackedCover *cover, int skip, char *dropped, PackedCover *donts) {
+    int i, k;
+    int num_words = cover->num_words;
+    int num_cofactor = 0;
+    uint64_t *cube = &cover->cubes[(size_t)skip * num_words];
+    uint64_t *cofactor = malloc((size_t)(cover->num_cubes + donts->num_cubes) * num_words * sizeof(uint64_t));
+
+    // cube is covered iff the rest, cofactored against it, is a tautology
+    for (i = 0; i < cover->num_cubes + donts->num_cubes; i++) {
+        uint64_t *other = (i < cover->num_cubes) ? &cover->cubes[(size_t)i * num_words] : 
+                                                   &donts->cubes[(size_t)(i - cover->num_cubes) * num_words];
+        if (i == skip || (i < cover->num_cubes && dropped[i]) || 
+            conflictingFields(other, cube, num_words) > 0)
+            continue;
+        for (k = 0; k < num_words; k++) {
+            cofactor[(size_t)num_cofactor * num_words + k] = other[k] | ~cube[k];
+        }
+        num_cofactor++;
+    }
+
+    int covered = isTautology(cofactor, num_cofactor, num_words, num_words * 32);
+    free(cofactor);
+    return covered;
+}
+
+int countLiterals(const uint64_t *cube, int num_words) {
+    int literals = 0;
+
+    // A literal is a field with exactly one bit set
+    for (int i = 0; i < num_words; i++) {
+        literals += __builtin_popcountll((cube[i] ^ (cube[i] >> 1)) & FIELD_LOW_BITS);
+    }
+    return literals;
+}
+
+void minimizeCubes(char **cubes, int num_cubes, char **dont_cubes, int num_dont_cubes, 
+                   int num_variables, int printEnabled, char **cover_out) {
+    int i, j;
+    int num_words = (num_variables + 31) / 32;
+    int num_result = 0;
+    double start_time, run_time;
+    char binary[MAX_VARS + 1];
+    char expr[EXPR_LEN(MAX_VARS)];
+    char *dropped;
+    uint64_t cube[CUBE_WORDS];
+    PackedCover primes = {NULL, 0, 0, num_words};
+    PackedCover donts = {NULL, 0, 0, num_words};
+    Expression *result = NULL;
+
+    PRINT(60, '=');
+    NEW_LINE(1);
+    printf("Iterated consensus on %d cubes\n", num_cubes);
+    if (cover_out != NULL)
+        (*cover_out) = NULL;
+
+    for (i = 0; i < num_cubes + num_dont_cubes; i++) {
+        char *text = (i < num_cubes) ? cubes[i] : dont_cubes[i - num_cubes];
+        if ((int)strlen(text) != num_variables || strspn(text, "01-") != strlen(text)) {
+            printf("Cube %s is not %d chars of 0, 1 and -\n", text, num_variables);
+            free(primes.cubes);
+            free(donts.cubes);
+            return;
+        }
+        packCube(text, cube, num_words);
+        appendPackedCube(&primes, cube);
+        if (i >= num_cubes)
+            appendPackedCube(&donts, cube);
+    }
+
+    start_time = omp_get_wtime();
+    generatePrimesByConsensus(&primes);
+    run_time = omp_get_wtime();
+    if(printEnabled) {
+        printf("\n\x1B[33mPrime implicants:\033[0m\n");
+        for (i = 0; i < primes.num_cubes; i++) {
+            unpackCube(&primes.cubes[(size_t)i * num_words], num_variables, binary);
+            printf("    Set%2d:  %s\n", i, binary);
+        }
+    } else {
+        printf("Finding %d prime implicants took %.2fs...\n", primes.num_cubes, (run_time - start_time));
+    }
+
+    // Sort so the primes with most literals are tried for removal first
+    for (i = 0; i < primes.num_cubes; i++) {
+        for (j = 0; j < primes.num_cubes - 1 - i; j++) {
+            uint64_t *first = &primes.cubes[(size_t)j * num_words];
+            uint64_t *second = &primes.cubes[(size_t)(j + 1) * num_words];
+            if (countLiterals(first, num_words) < countLiterals(second, num_words)) {
+                memcpy(cube, first, num_words * sizeof(uint64_t));
+                memcpy(first, second, num_words * sizeof(uint64_t));
+                memcpy(second, cube, num_words * sizeof(uint64_t));
+            }
+        }
+    }
+
+    // Irredundant cover without minterms, a prime goes if the others and the
+    // don't cares already cover it. Primes that are all don't care go too
+    start_time = omp_get_wtime();
+    dropped = calloc(primes.num_cubes + 1, sizeof(char));
+    for (i = 0; i < primes.num_cubes; i++) {
+        dropped[i] = coveredByOthers(&primes, i, dropped, &donts);
+    }
+    for (i = 0; i < primes.num_cubes; i++) {
+        if (dropped[i])
+            continue;
+        unpackCube(&primes.cubes[(size_t)i * num_words], num_variables, binary);
+        convertBinaryToExpression(binary, num_variables, FORM_SOP, expr);
+        appendExpression(&result, &num_result, expr);
+    }
+    run_time = omp_get_wtime();
+
+    // Nothing left means the function is 0
+    if (num_result == 0)
+        appendExpression(&result, &num_result, "0");
+    if(!printEnabled)
+        printf("Finding an irredundant cover took %.2fs...\n", (run_time - start_time));
+    else
+        printExpression(result, num_result, FORM_SOP);
+    PRINT(60, '=');
+    NEW_LINE(1);
+
+    if (cover_out != NULL)
+        (*cover_out) = joinExpression(result, num_result, FORM_SOP);
+    deleteExpression(result, num_result);
+    free(dropped);
+    free(primes.cubes);
+    free(donts.cubes);
+}
+
+int parseCubeList(char *text, char ***list) {
+    int num_list = 0;
+
+    (*list) = malloc((strlen(text) / 2 + 1) * sizeof(char *));
+    for (char *token = strtok(text, ","); token != NULL; token = strtok(NULL, ",")) {
+        (*list)[num_list++] = token;
+    }
+    return num_list;
+}
+
+int writeAll(int fd, const void *buffer, size_t length) {
+    const char *bytes = buffer;
+
+    while (length > 0) {
+        ssize_t written = write(fd, bytes, length);
+        if (written <= 0)
+            return 0;
+        bytes += written;
+        length -= written;
+    }
+    return 1;
+}
+
+int readAll(int fd, void *buffer, size_t length) {
+    char *bytes = buffer;
+
+    while (length > 0) {
+        ssize_t got = read(fd, bytes, length);
+        if (got <= 0)
+            return 0;
+        bytes += got;
+        length -= got;
+    }
+    return 1;
+}
+
+int sendMessage(int fd, const void *payload, uint32_t length) {
+    return writeAll(fd, &length, sizeof(length)) && writeAll(fd, payload, length);
+}
+
+void *receiveMessage(int fd, uint32_t *length) {
+    char *payload;
+
+    if (!readAll(fd, length, sizeof(*length)) || (*length) > MAX_REQUEST_BYTES)
+        return NULL;
+    payload = malloc((*length) + 1);
+    if (payload == NULL || !readAll(fd, payload, (*length))) {
+        free(payload);
+        return NULL;
+    }
+    payload[(*length)] = '\0';
+    return payload;
+}
+
+int connectServer(const char *path) {
+    struct sockaddr_un address;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0)
+        return -1;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void handleRequest(int fd) {
+    int i;
+    uint32_t length;
+    int32_t *request = receiveMessage(fd, &length);
+    int num_fields = length / sizeof(int32_t);
+    char *cover = NULL;
+    char *response;
+    double start_time, run_time;
+
+    // Request: REQUEST_FIELDS int32 options followed by the minterms and don't cares.
+    // Options are checked here since they reach fork() and calloc() sizes
+    if (request == NULL || length % sizeof(int32_t) != 0 || num_fields < REQUEST_FIELDS ||
+        request[0] < 1 || request[0] > MAX_MINTERM_VARS || request[1] < 0 || request[2] < 0 || 
+        request[1] > num_fields || request[2] > num_fields ||
+        num_fields != REQUEST_FIELDS + request[1] + request[2] ||
+        (request[3] != FORM_AUTO && request[3] != FORM_SOP && request[3] != FORM_POS) ||
+        request[4] < 0 || request[4] > SERVER_MAX_SHARD_VARS || request[5] < 0 ||
+        (request[6] != COVER_EXACT && request[6] != COVER_GREEDY)) {
+        const char *error = "error malformed request\n";
+        sendMessage(fd, error, strlen(error));
+        free(request);
+        return;
+    }
+    int num_variables = request[0];
+    int num_minterms = request[1];
+    int num_donts = request[2];
+    int *minterms = &request[REQUEST_FIELDS];
+    int *donts = &request[REQUEST_FIELDS + num_minterms];
+
+    for (i = 0; i < num_minterms + num_donts; i++) {
+        if (minterms[i] < 0 || minterms[i] >= (1 << num_variables))
+            break;
+    }
+    if (i < num_minterms + num_donts) {
+        const char *error = "error minterm out of range\n";
+        sendMessage(fd, error, strlen(error));
+        free(request);
+        return;
+    }
+
+    // The arenas hold MAX_SETS sets, a POS request brings its whole off-set
+    if (countInputSets(num_minterms, num_donts, num_variables, 
+                       chooseForm(num_minterms, num_donts, num_variables, request[3])) > MAX_SETS) {
+        const char *error = "error more than MAX_SETS sets\n";
+        sendMessage(fd, error, strlen(error));
+        free(request);
+        return;
+    }
+
+    // Engine options only last for this request
+    OUTPUT_FORM = request[3];
+    NUM_SHARD_VARS = request[4];
+    MEMORY_BUDGET = (long)request[5] * 1024;
+    COVER_MODE = request[6];
+
+    start_time = omp_get_wtime();
+    mcluskey(minterms, num_minterms, num_variables, 
+             num_donts ? donts : NULL, num_donts, 0, &cover);
+    run_time = omp_get_wtime() - start_time;
+
+    // Response: "F = <cover>" and the solve time in seconds, one per line
+    if (cover != NULL) {
+        response = malloc(strlen(cover) + 64);
+        sprintf(response, "F = %s\ntime %.6f\n", cover, run_time);
+    } else {
+        response = malloc(64);
+        sprintf(response, "error could not minimize\ntime %.6f\n", run_time);
+    }
+    sendMessage(fd, response, strlen(response));
+
+    OUTPUT_FORM = FORM_AUTO;
+    NUM_SHARD_VARS = 0;
+    MEMORY_BUDGET = 0;
+    COVER_MODE = COVER_EXACT;
+    free(response);
+    free(cover);
+    free(request);
+}
+
+int runServer(const char *path) {
+    struct sockaddr_un address;
+    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (server_fd < 0) {
+        printf("Error creating socket\n");
+        return 1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    unlink(path);
+    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) != 0 || 
+        listen(server_fd, SERVER_BACKLOG) != 0) {
+        printf("Error listening on %s\n", path);
+        close(server_fd);
+        return 1;
+    }
+    // A client hanging up early must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+
+    // Start the thread pool and the arenas once, every request reuses them
+    if (ENABLE_MP) {
+        omp_set_num_threads(NUM_THREADS);
+        #pragma omp parallel
+        { }
+    }
+    arenaSets(&GROUPS_ARENA);
+    arenaSets(&NEW_GROUPS_ARENA);
+    arenaSets(&PRIMES_ARENA);
+
+    printf("Listening on %s\n", path);
+    fflush(stdout);
+    // The per request progress output has nowhere to go
+    freopen("/dev/null", "w", stdout);
+
+    // One request per connection, served in arrival order. A client that
+    // stalls is dropped after SERVER_TIMEOUT so it cannot hold up the queue
+    while (1) {
+        struct timeval timeout = {SERVER_TIMEOUT, 0};
+        int client_fd = accept(server_fd, NULL, NULL);
+        if (client_fd < 0)
+            continue;
+        setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        handleRequest(client_fd);
+        close(client_fd);
+    }
+    return 0;
+}
+
+char *requestCover(const char *path, int num_variables, int *minterms, int num_minterms, 
+                   int *donts, int num_donts) {
+    int i;
+    uint32_t length;
+    char *response = NULL;
+    int num_fields = REQUEST_FIELDS + num_minterms + num_donts;
+    int32_t *request = malloc(num_fields * sizeof(int32_t));
+    int fd = connectServer(path);
+
+    if (fd < 0) {
+        free(request);
+        return NULL;
+    }
+    request[0] = num_variables;
+    request[1] = num_minterms;
+    request[2] = num_donts;
+    request[3] = OUTPUT_FORM;
+    request[4] = NUM_SHARD_VARS;
+    request[5] = MEMORY_BUDGET / 1024;
+    request[6] = COVER_MODE;
+    for (i = 0; i < num_minterms; i++) {
+        request[REQUEST_FIELDS + i] = minterms[i];
+    }
+    for (i = 0; i < num_donts; i++) {
+        request[REQUEST_FIELDS + num_minterms + i] = donts[i];
+    }
+
+    if (sendMessage(fd, request, num_fields * sizeof(int32_t)))
+        response = receiveMessage(fd, &length);
+    close(fd);
+    free(request);
+    return response;
+}
+
+int parseList(char *text, int **list) {
+    int num_list = 0;
+    char *token = strtok(text, ",");
+
+    (*list) = NULL;
+    while (token != NULL) {
+        (*list) = realloc((*list), (num_list + 1) * sizeof(int));
+        (*list)[num_list++] = atoi(token);
+        token = strtok(NULL, ",");
+    }
+    return num_list;
+}
+
+int runClient(const char *path, int num_variables, char *minterm_list, char *dont_list) {
+    int *minterms, *donts = NULL;
+    int num_minterms = parseList(minterm_list, &minterms);
+    int num_donts = (dont_list != NULL) ? parseList(dont_list, &donts) : 0;
+    double start_time = omp_get_wtime();
+    char *response = requestCover(path, num_variables, minterms, num_minterms, donts, num_donts);
+    double run_time = omp_get_wtime() - start_time;
+
+    free(minterms);
+    free(donts);
+    if (response == NULL) {
+        printf("No response from %s\n", path);
+        return 1;
+    }
+    printf("%slatency %.6f\n", response, run_time);
+    free(response);
+    return 0;
+}
+
+int compareDoubles(const void* p, const void* q) {
+    double left = *((const double *)p);
+    double right = *((const double *)q);
+    return (left > right) - (left < right);
+}
+
+int runLoad(const char *path, int num_clients, int num_requests, int num_variables) {
+    int num_total = num_clients * num_requests;
+    int num_failed = 0;
+    double *latencies;
+    double start_time, run_time;
+
+    if (num_clients < 1 || num_requests < 1) {
+        printf("Load generator needs at least 1 client and 1 request\n");
+        return 1;
+    }
+    if (num_variables < 1 || num_variables > 16) {
+        printf("Load generator supports 1 to 16 variables\n");
+        return 1;
+    }
+    latencies = malloc((long)num_clients * num_requests * sizeof(double));
+
+    // Every client sends its requests back to back, each a fresh random function
+    start_time = omp_get_wtime();
+    #pragma omp parallel num_threads(num_clients) reduction(+:num_failed)
+    {
+        int client = omp_get_thread_num();
+        unsigned int seed = 12345 + client;
+        int *minterms = malloc((1 << num_variables) * sizeof(int));
+
+        for (int r = 0; r < num_requests; r++) {
+            int num_minterms = 0;
+            for (int m = 0; m < (1 << num_variables); m++) {
+                if (rand_r(&seed) % 2)
+                    minterms[num_minterms++] = m;
+            }
+            double request_start = omp_get_wtime();
+            char *response = requestCover(path, num_variables, minterms, num_minterms, NULL, 0);
+            latencies[client * num_requests + r] = omp_get_wtime() - request_start;
+            if (response == NULL || strncmp(response, "F = ", 4) != 0)
+                num_failed++;
+            free(response);
+        }
+        free(minterms);
+    }
+    run_time = omp_get_wtime() - start_time;
+
+    qsort(latencies, num_total, sizeof(double), compareDoubles);
+    printf("%d requests from %d clients in %.2fs, %.1f req/s, %d failed\n", 
+           num_total, num_clients, run_time, num_total / run_time, num_failed);
+    printf("latency p50 %.3fms p99 %.3fms max %.3fms\n", 
+           latencies[num_total / 2] * 1000, latencies[(num_total * 99) / 100] * 1000, 
+           latencies[num_total - 1] * 1000);
+    free(latencies);
+    return num_failed > 0;
+}
+
+// Other front ends (src/bench.c) include this file and bring their own main
+#ifndef QM_NO_MAIN
+void usage(const char *prog) {
+    printf("Usage: %s [-f sop|pos|auto] [-s vars] [-m MB] [-c exact|greedy] <demo>\n", prog);
+    printf("       %s serve <socket>\n", prog);
+    printf("       %s [-f sop|pos|auto] [-s vars] [-m MB] [-c exact|greedy] client <socket> <vars> <m,m,...> [<d,d,...>]\n", prog);
+    printf("       %s load <socket> <clients> <requests> <vars>\n", prog);
+    printf("       %s cubes <vars> <cube,cube,...> [<cube,cube,...>]\n", prog);
+    printf("  -f    output form, auto switches to POS for dense on-sets (default auto)\n");
+    printf("  -s    split on this many top variables and minimize each cofactor in a worker process\n");
+    printf("  -m    memory budget in MB, merge levels above it are merged from temporary files\n");
+    printf("  -c    covering, greedy picks the prime covering most minterms left, then drops redundant ones (default exact)\n");
 }
 
 int main(int argc, char **argv) {
+    int opt;
+    char *demo;
+
+    // Stop at the first positional so cubes such as -01- are not read as options
+    while ((opt = getopt(argc, argv, "+f:s:m:c:")) != -1) {
+        switch (opt) {
+            case 'f':
+                if (!strcmp(optarg, "sop"))
+                    OUTPUT_FORM = FORM_SOP;
+                else if (!strcmp(optarg, "pos"))
+                    OUTPUT_FORM = FORM_POS;
+                else if (!strcmp(optarg, "auto"))
+                    OUTPUT_FORM = FORM_AUTO;
+                else {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 's':
+                NUM_SHARD_VARS = atoi(optarg);
+                break;
+            case 'm':
+                MEMORY_BUDGET = (long)(atof(optarg) * 1024 * 1024);
+                break;
+            case 'c':
+                if (!strcmp(optarg, "exact"))
+                    COVER_MODE = COVER_EXACT;
+                else if (!strcmp(optarg, "greedy"))
+                    COVER_MODE = COVER_GREEDY;
+                else {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+    demo = argv[optind];
+
+    // Shard worker, reads one cofactor from stdin and answers on stdout
+    if(!strcmp(demo,"worker")) {
+        return shardWorker();
+    }
+
+    // Server mode and its client and load generator
+    if(!strcmp(demo,"serve") && optind + 1 < argc) {
+        return runServer(argv[optind + 1]);
+    }
+    if(!strcmp(demo,"client") && optind + 3 < argc) {
+        return runClient(argv[optind + 1], atoi(argv[optind + 2]), argv[optind + 3], 
+                         (optind + 4 < argc) ? argv[optind + 4] : NULL);
+    }
+    if(!strcmp(demo,"load") && optind + 4 < argc) {
+        return runLoad(argv[optind + 1], atoi(argv[optind + 2]), atoi(argv[optind + 3]), 
+                       atoi(argv[optind + 4]));
+    }
 
-    if(!strcmp(argv[1],"0")) {
+    // Cube input such as 1-0-,01--, don't care cubes optional. Primes come from
+    // iterated consensus so there is no minterm limit, only MAX_VARS
+    if(!strcmp(demo,"cubes") && optind + 2 < argc) {
+        char **cubes, **dont_cubes = NULL;
+        int num_variables = atoi(argv[optind + 1]);
+        int num_cubes = parseCubeList(argv[optind + 2], &cubes);
+        int num_dont_cubes = (optind + 3 < argc) ? parseCubeList(argv[optind + 3], &dont_cubes) : 0;
+        if (num_variables < 1 || num_variables > MAX_VARS) {
+            printf("Cube input takes 1 to %d variables\n", MAX_VARS);
+            return 1;
+        }
+        minimizeCubes(cubes, num_cubes, dont_cubes, num_dont_cubes, num_variables, 1, NULL);
+        free(cubes);
+        free(dont_cubes);
+        return 0;
+    }
+
+    if(!strcmp(demo,"0")) {
         // Example without don't cares
         char input[1024];
         int minterms[1024];
@@ -837,31 +2740,31 @@ int main(int argc, char **argv) {
         }
         printf("How many variables:");
         scanf("%d", &num_variables);    
-        mcluskey(minterms, num_minterms, num_variables, NULL, 0, 1);
+        mcluskey(minterms, num_minterms, num_variables, NULL, 0, 1, NULL);
     }
 
     // Demo 1
-    if(!strcmp(argv[1],"1")) {
+    if(!strcmp(demo,"1")) {
         // Example without don't cares
         int minterms[] = {0, 1, 2, 5, 7, 8, 9, 10, 13, 15};
         int num_minterms = ARR_LEN(minterms); 
         int num_variables = 4; // Must be exactly enough to accomodate the biggest minterm
-        mcluskey(minterms, num_minterms, num_variables, NULL, 0, 1);
+        mcluskey(minterms, num_minterms, num_variables, NULL, 0, 1, NULL);
     }
 
     // Demo 2
-    if(!strcmp(argv[1],"2")) {
+    if(!strcmp(demo,"2")) {
         // Example with don't cares
         int minterms[] = {2, 4, 6, 8, 10, 12, 32, 128};
         int donts[] = {3, 5};
         int num_minterms = ARR_LEN(minterms); 
         int num_donts = ARR_LEN(donts);
         int num_variables = 7; // 2^7 = 128 = our biggest minterm
-        mcluskey(minterms, num_minterms, num_variables, donts, num_donts, 1); 
+        mcluskey(minterms, num_minterms, num_variables, donts, num_donts, 1, NULL); 
     }
 
     // Demo 3
-    if(!strcmp(argv[1],"3")) {
+    if(!strcmp(demo,"3")) {
         // Example of stressing the code 
         srand(time(NULL));
         int num_minterms = 0;
@@ -872,11 +2775,11 @@ int main(int argc, char **argv) {
         }
         //bubbleSort(minterms, num_minterms);
         int num_variables = 6;
-        mcluskey(minterms, num_minterms, num_variables, NULL, 0, 1);
+        mcluskey(minterms, num_minterms, num_variables, NULL, 0, 1, NULL);
     }
 
     // Demo 4
-    if(!strcmp(argv[1],"4")) {
+    if(!strcmp(demo,"4")) {
         // Example of stressing the code 
         int num_minterms = 4096;
         int minterms[num_minterms];
@@ -884,8 +2787,9 @@ int main(int argc, char **argv) {
             minterms[i] = i;
         }
         int num_variables = 12;
-        mcluskey(minterms, num_minterms, num_variables, NULL, 0, 0);
+        mcluskey(minterms, num_minterms, num_variables, NULL, 0, 0, NULL);
     }
 
     return 0;
-}
\ No newline at end of file
+}
+#endif